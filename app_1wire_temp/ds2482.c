@@ -4,6 +4,13 @@
  *
  *   DS2482 Driver
  *
+ *   Uses the blocking i2c.c calls, unless DS2482_I2CQ is defined (see
+ *   project.h). Then it talks to the DS2482 through the i2cq.c
+ *   transaction queue instead, so a DS2482 or bus that stops responding
+ *   fails the call after a timeout, and gets the bus reset, rather than
+ *   hanging the board. Each call still waits for its own transactions,
+ *   running systime timers and other queue callbacks in the meantime.
+ *
  *   This is free software: you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
  *   the Free Software Foundation, either version 2 of the License, or
@@ -20,14 +27,25 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "ds2482.h"
 #include "onewire.h"
+#ifdef DS2482_I2CQ
+#include "i2cq.h"
+#include "systime.h"
+#else
 #include "i2c.h"
+#endif /* DS2482_I2CQ */
 
 #ifdef _OW_DS2482_
 
+#ifdef DS2482_I2CQ
+#define DS2482_TIMEOUT_MS               50      /* For any one I2C transaction */
+#define DS2482_BUSY_MS                  20      /* 1-Wire reset is the longest, at about 1.2ms */
+#else
 #define DS2482_WAIT_CYCLES              255
+#endif /* DS2482_I2CQ */
 
 #define DS2482_CMD_RESET                0xF0    /* No param */
 #define DS2482_CMD_SET_READ_PTR         0xE1    /* Param: DS2482_PTR_CODE_xxx */
@@ -76,6 +94,93 @@ static uint8_t _g_devAddr;
 
 static bool ds2482_reset(void);
 
+#ifdef DS2482_I2CQ
+
+/* Queues one transaction and waits for it to complete or time out */
+static bool ds2482_xfer(const uint8_t *tx, int txlen, uint8_t *rx, int rxlen)
+{
+    i2cq_txn_t txn;
+
+    txn.devaddr = _g_devAddr;
+    txn.tx = tx;
+    txn.txlen = txlen;
+    txn.rx = rx;
+    txn.rxlen = rxlen;
+    txn.timeout = DS2482_TIMEOUT_MS;
+    txn.callback = NULL;
+    txn.ctx = NULL;
+
+    i2cq_submit(&txn);
+
+    while (txn.result == I2CQ_PENDING)
+    {
+        systime_process();
+        i2cq_process();
+    }
+
+    /* It's on the completed list until this runs, and it's on our stack */
+    i2cq_process();
+
+    return txn.result == I2CQ_OK;
+}
+
+static bool ds2482_write(uint8_t cmd, uint8_t param)
+{
+    uint8_t buf[2];
+
+    buf[0] = cmd;
+    buf[1] = param;
+
+    return ds2482_xfer(buf, sizeof(buf), NULL, 0);
+}
+
+static bool ds2482_write_cmd(uint8_t cmd)
+{
+    return ds2482_xfer(&cmd, 1, NULL, 0);
+}
+
+/* 1-Wire commands leave the read pointer on the status register */
+static bool ds2482_await_idle(uint8_t *status)
+{
+    uint32_t start = systime_ms();
+
+    do
+    {
+        if (!ds2482_xfer(NULL, 0, status, 1))
+            return false;
+
+        if (!(*status & DS2482_REG_STATUS_1WB))
+            return true;
+
+    } while (systime_ms() - start < DS2482_BUSY_MS);
+
+    return false;
+}
+
+#else
+
+static bool ds2482_xfer(const uint8_t *tx, int txlen, uint8_t *rx, int rxlen)
+{
+    return i2c_xfer(_g_devAddr, tx, txlen, rx, rxlen);
+}
+
+static bool ds2482_write(uint8_t cmd, uint8_t param)
+{
+    return i2c_write(_g_devAddr, cmd, param);
+}
+
+static bool ds2482_write_cmd(uint8_t cmd)
+{
+    return i2c_write_byte(_g_devAddr, cmd);
+}
+
+static bool ds2482_await_idle(uint8_t *status)
+{
+    return i2c_await_flag(_g_devAddr, DS2482_REG_STATUS_1WB, status, DS2482_WAIT_CYCLES);
+}
+
+#endif /* DS2482_I2CQ */
+
 bool ds2482_init(void)
 {
     uint8_t cfg = DS2482_REG_CFG_APU;
@@ -85,7 +190,7 @@ bool ds2482_init(void)
     if (!ds2482_reset())
         return false;
 
-    if (!i2c_write(_g_devAddr, DS2482_CMD_WRITE_CONFIG, (cfg) | (~cfg) << 4))
+    if (!ds2482_write(DS2482_CMD_WRITE_CONFIG, (cfg) | (~cfg) << 4))
         return false;
 
     return true;
@@ -93,12 +198,11 @@ bool ds2482_init(void)
 
 static bool ds2482_reset(void)
 {
+    uint8_t cmd = DS2482_CMD_RESET;
     uint8_t status;
     
-    if (!i2c_write_byte(_g_devAddr, DS2482_CMD_RESET))
-        return false;
-    
-    if (!i2c_read_byte(_g_devAddr, &status))
+    /* Reset leaves the read pointer on the status register */
+    if (!ds2482_xfer(&cmd, 1, &status, 1))
         return false;
 
     if ((status & 0xF7) != 0x10)
@@ -113,10 +217,10 @@ bool ds2482_bus_reset(bool *presense_detect)
 
     *presense_detect = true;
 
-    if (!i2c_write_byte(_g_devAddr, DS2482_CMD_1WIRE_RESET))
+    if (!ds2482_write_cmd(DS2482_CMD_1WIRE_RESET))
         return false;
 
-    if (!i2c_await_flag(_g_devAddr, DS2482_REG_STATUS_1WB, &status, DS2482_WAIT_CYCLES))
+    if (!ds2482_await_idle(&status))
         return false;
 
     /* Check for short condition */
@@ -166,19 +270,18 @@ bool ds2482_command(uint8_t command, uint8_t *id)
 
 bool ds2482_read_byte(uint8_t *ret)
 {
+    uint8_t setptr[2] = { DS2482_CMD_SET_READ_PTR, DS2482_PTR_CODE_DATA };
     uint8_t data;
     uint8_t status;
 
-    if (!i2c_write_byte(_g_devAddr, DS2482_CMD_1WIRE_READ_BYTE))
-        return false;
-
-    if (!i2c_await_flag(_g_devAddr, DS2482_REG_STATUS_1WB, &status, DS2482_WAIT_CYCLES))
+    if (!ds2482_write_cmd(DS2482_CMD_1WIRE_READ_BYTE))
         return false;
 
-    if (!i2c_write(_g_devAddr, DS2482_CMD_SET_READ_PTR, DS2482_PTR_CODE_DATA))
+    if (!ds2482_await_idle(&status))
         return false;
 
-    if (!i2c_read_byte(_g_devAddr, &data))
+    /* Point at the data register and read it back in one transaction */
+    if (!ds2482_xfer(setptr, sizeof(setptr), &data, 1))
         return false;
 
     *ret = data;
@@ -189,10 +292,10 @@ bool ds2482_write_byte(uint8_t data)
 {
     uint8_t status;
 
-    if (!i2c_write(_g_devAddr, DS2482_CMD_1WIRE_WRITE_BYTE, data))
+    if (!ds2482_write(DS2482_CMD_1WIRE_WRITE_BYTE, data))
         return false;
 
-    if (!i2c_await_flag(_g_devAddr, DS2482_REG_STATUS_1WB, &status, DS2482_WAIT_CYCLES))
+    if (!ds2482_await_idle(&status))
         return false;
 
     return true;
@@ -227,10 +330,10 @@ uint8_t ds2482_rom_search(uint8_t diff, uint8_t *id)
             if (diff > i || (*id & 1) && diff != i) /* Use '1' on this pass */
                 search_direction = DS2482_CMD_1WIRE_TRIPLET_DIR;
 
-            if (!i2c_write(_g_devAddr, DS2482_CMD_1WIRE_TRIPLET, search_direction))
+            if (!ds2482_write(DS2482_CMD_1WIRE_TRIPLET, search_direction))
                 return OW_COMMS_ERR;
 
-            if (!i2c_await_flag(_g_devAddr, DS2482_REG_STATUS_1WB, &status, DS2482_WAIT_CYCLES))
+            if (!ds2482_await_idle(&status))
                 return OW_COMMS_ERR;
 
             if ((status & DS2482_REG_STATUS_SBR) && (status & DS2482_REG_STATUS_TSB))
@@ -263,7 +366,7 @@ bool ds2482_select_channel(uint8_t channel)
     if (channel >= 8)
         return false;
     
-    if (!i2c_write(_g_devAddr, DS2482_CMD_CHANNEL_SELECT, ds2482_chan_wr[channel]))
+    if (!ds2482_write(DS2482_CMD_CHANNEL_SELECT, ds2482_chan_wr[channel]))
         return false;
     
     return true;
@@ -26,9 +26,13 @@
 #include <string.h>
 
 #include "eod_io.h"
-#include "i2c.h"
+#ifdef DS2482_I2CQ
+#include "i2cq.h"
+#include "irq.h"
+#include "systime.h"
+#endif /* DS2482_I2CQ */
+#include "clock.h"
 #include "uart.h"
-#include "util.h"
 #include "onewire.h"
 #include "ds18x20.h"
 
@@ -39,11 +43,16 @@ static char *dots_for(const char *str);
 
 #define MAX_DESC 16
 
+/* DS18B20 takes up to 750ms to convert at 12 bits */
+#define CONVERSION_MS 1000
+
 char _g_dotBuf[MAX_DESC];
 
 void interrupt_handler(void)
 {
-    /* Unused */
+#ifdef DS2482_I2CQ
+    irq_dispatch();
+#endif /* DS2482_I2CQ */
 }
 
 void main(void)
@@ -53,6 +62,13 @@ void main(void)
     uart_open(UARTA, 9600, 8, PARITY_NONE, 1, 0);
     setup_printf(UARTA);
 
+#ifdef DS2482_I2CQ
+    /* The DS2482 is driven through i2cq.c, which times out on systime */
+    systime_init();
+    i2cq_init();
+    cpld_write(CONFIG, CONFIG_GINT, CONFIG_GINT);
+#endif /* DS2482_I2CQ */
+
     ow_init();
 
     if (ds18x20_search_sensors(&num_sensors, _g_sensor_ids))
@@ -62,17 +78,24 @@ void main(void)
 
     while (1)
     {
+#ifdef DS2482_I2CQ
+        uint32_t start;
+#endif /* DS2482_I2CQ */
+
         for (int i = 0; i < num_sensors; i++)
             ds18x20_start_meas(_g_sensor_ids[i]);
 
-        // Nearly 1 second
-        delay_ncycles(65535);
-        delay_ncycles(65535);
-        delay_ncycles(65535);
-        delay_ncycles(65535);
-        delay_ncycles(65535);
-        delay_ncycles(65535);
-        delay_ncycles(65535);
+#ifdef DS2482_I2CQ
+        start = systime_ms();
+
+        while (systime_ms() - start < CONVERSION_MS)
+        {
+            systime_process();
+            i2cq_process();
+        }
+#else
+        delay_ms(CONVERSION_MS);
+#endif /* DS2482_I2CQ */
 
         for (int i = 0; i < num_sensors; i++)
         {
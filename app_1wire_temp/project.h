@@ -22,6 +22,14 @@
 #define __PROJECT_H__
 
 #define _OW_DS2482_
+
+/*   Drive the DS2482 through the interrupt driven i2cq.c, rather than the
+ *   blocking i2c.c calls, so a stuck bus times out instead of hanging.
+ *   Needs the PCF8584's INT wired to GFP3 (EXTINTB), which stock boards
+ *   don't have, or it never sees a byte complete. Or build with
+ *   -dDS2482_I2CQ.
+ */
+//#define DS2482_I2CQ
 #define MAX_SENSORS 8
 
 #ifdef _DS18X20_SINGLE_DEV_PER_CHANNEL_
@@ -24,32 +24,79 @@
 #include <string.h>
 
 #include "eod_io.h"
+#include "eod_map.h"
 #include "uart.h"
 #include "adc.h"
+#include "adccap.h"
+#include "irq.h"
+#include "farheap.h"
+
+/* Build with -dSTREAM_BINARY to send packed 12-bit samples (see
+ * adccap_pack()) instead of text.
+ */
+#ifdef STREAM_BINARY
+#define CAPTURE_HZ          400     /* 6400 samples/s, about 9.6KB/s */
+#else
+#define CAPTURE_HZ          3       /* TIMER can't go slower than TIMER_HZ / 0xFFFF, about 2.5Hz */
+#endif
+
+#define CAPTURE_SAMPLES     ADCCAP_MAX_SAMPLES
 
 void interrupt_handler(void)
 {
-    /* Unused */
+    irq_dispatch();
 }
 
 void main(void)
 {
-    int i = 0;
+    uint16_t results[ADC_NUM_CHANNELS];
+    adccap_stats_t stats;
+    uint32_t hz;
+
     uart_open(UARTA, 115200, 8, PARITY_NONE, 1, 0);
     setup_printf(UARTA);
 
+    if (!adccap_init(farheap_alloc_seg((uint32_t)CAPTURE_SAMPLES * sizeof(uint16_t)), CAPTURE_SAMPLES))
+    {
+        printf("No far RAM for the capture ring\r\n");
+        while (1);
+    }
+
+    /* All 16 channels every tick */
+    hz = adccap_start(0xFFFF, CAPTURE_HZ);
+
+    if (!hz)
+    {
+        printf("Can't capture at %luHz\r\n", (uint32_t)CAPTURE_HZ);
+        while (1);
+    }
+
+    cpld_write(CONFIG, CONFIG_GINT, CONFIG_GINT);
+
+#ifdef STREAM_BINARY
+    (void)results;
+    (void)stats;
+    (void)hz;
+
+    while (1)
+        adccap_stream_uart(UARTA, ADC_NUM_CHANNELS);
+#else
+    printf("Capturing at %luHz\r\n", hz);
+
     while (1)
     {
         int channel;
-        for (channel = 0; channel < 16; channel++)
-        {
-            uint16_t result = adc_read_channel(channel);
-            printf("ADC channel %02d: read level %u of %u\r\n", channel, result, ADC_MAX_LEVEL);
-            
-            for(i = 0; i < 0x4000; i++);
-        }
-
-        printf("\r\n");
+
+        if (adccap_available() < ADC_NUM_CHANNELS)
+            continue;
+
+        adccap_read(results, ADC_NUM_CHANNELS);
+
+        for (channel = 0; channel < ADC_NUM_CHANNELS; channel++)
+            printf("ADC channel %02d: read level %u of %u\r\n", channel, results[channel], ADC_MAX_LEVEL);
+
+        adccap_get_stats(&stats);
+        printf("%lu sweeps, %lu overruns, high water %u samples\r\n\r\n", stats.sweeps, stats.overruns, stats.high_water);
     }
+#endif /* STREAM_BINARY */
 }
-
@@ -37,6 +37,8 @@
 #define GREEN       5        /* Green color pin of RGB LED */
 #define BLUE        6        /* Blue color pin of RGB LED */
 
+#define GLYPH_DEGREE 0
+
 #define COLD        23       /* Cold temperature, drive blue LED (23c) */
 #define HOT         26       /* Hot temperature, drive red LED (27c) */
 
@@ -60,6 +62,8 @@ const uint8_t numberlookup[16] =
     0x71
 };
 
+const char degree[8] = { 0x06, 0x09, 0x09, 0x06, 0x00, 0x00, 0x00, 0x00 };
+
 void setup();
 void update_rgb(uint8_t temp_h);
 void cal_temp(int *decimal, uint8_t *high, uint8_t *low, uint8_t *sign);
@@ -72,6 +76,7 @@ void interrupt_handler(void)
 
 void main(void)
 { 
+    uint8_t segsetup[5] = { 0x47, 0x00, 0x00, 0x00, 0x00 };
     int decimal;
     uint8_t temperature_h, temperature_l;
     uint8_t is_positive;
@@ -81,11 +86,15 @@ void main(void)
 
     cpld_write(TRISA, 0x68, 0); /* P3, 5, 6 output */
 
-    /* I2C SCL 117KHz @ 10MHz */
-    i2c_init(ICLK4, OCLK0);
+    /* Fastest standard mode SCL the detected clock allows. That's 84KHz
+     * @ 10MHz, as ICLK4/OCLK0's 117KHz is over 100KHz.
+     */
+    i2c_set_speed_hz(I2C_DEFAULT_HZ);
 
-    /* Configure 7-Segment to 12mA segment output current, Dynamic mode,  and Digits 1, 2, 3 AND 4 are NOT blanked */
-    i2c_write(_7SEG, 0x00, 0x47);
+    /* Configure 7-Segment to 12mA segment output current, Dynamic mode,  and Digits 1, 2, 3 AND 4 are NOT blanked.
+     * The SAA1064 auto-increments, so clear all four digits in the same transaction.
+     */
+    i2c_write_buf(_7SEG, 0x00, segsetup, sizeof(segsetup));
     
     /* Setup configuration register 12-bit */
     i2c_write(THERM, 0x01, 0x60);
@@ -104,12 +113,12 @@ void main(void)
         cal_temp(&decimal, &readtemp[0], &readtemp[1], &is_positive);
     
         memset(buf, 0x20, 40);
-        written = sprintf(buf, "The temperature is %s%u.%u degrees C", is_positive ? "" : "-", readtemp[0], decimal);
+        written = sprintf(buf, "The temperature is %s%u.%u%cC", is_positive ? "" : "-", readtemp[0], decimal,
+            lcd_glyph(0, GLYPH_DEGREE, degree));
         buf[written] = 0x20;
         buf[40] = 0x00;
-        lcd_clear01();
-        lcd_pos(0, 0);
-        lcd_string(buf);
+        lcd_fb_write(0, 0, buf);
+        lcd_flush();
         /* Update RGB LED.*/
         update_rgb(readtemp[0]);
     
@@ -149,19 +158,20 @@ void cal_temp(int *decimal, uint8_t *high, uint8_t *low, uint8_t *is_positive)
 
 void dis_7seg(int decimal, uint8_t high, uint8_t low, uint8_t sign)
 {
+    uint8_t digits[5] = { 0 };         /* Indexed by digit number. Unused digits are left clear */
     uint8_t digit = 4;                 /* Number of 7-Segment digit */
     uint8_t number;                    /* Temporary variable hold the number to display */
   
     if (sign == 0)                  /* When the temperature is negative */
     {
-        i2c_write(_7SEG, digit, 0x40); /* Display "-" sign */
+        digits[digit] = 0x40;         /* Display "-" sign */
         digit--;                      /* Decrement number of digit */
     }
   
     if (high > 99)                  /* When the temperature is three digits long */
     {
         number = high / 100;          /* Get the hundredth digit */
-        i2c_write(_7SEG, digit, numberlookup[number]);
+        digits[digit] = numberlookup[number];
         high = high % 100;            /* Remove the hundredth digit from the TempHi */
         digit--;                      /* Subtract 1 digit */    
     }
@@ -169,7 +179,7 @@ void dis_7seg(int decimal, uint8_t high, uint8_t low, uint8_t sign)
     if (high > 9)
     {
         number = high / 10;           /* Get the tenth digit */
-        i2c_write(_7SEG, digit, numberlookup[number]);
+        digits[digit] = numberlookup[number];
         high = high % 10;            /* Remove the tenth digit from the TempHi */
         digit--;                      /* Subtract 1 digit */
     }
@@ -182,26 +192,24 @@ void dis_7seg(int decimal, uint8_t high, uint8_t low, uint8_t sign)
         number = number | 0x80;
     }
 
-    i2c_write(_7SEG, digit, number);
+    digits[digit] = number;
     digit--;                        /* Subtract 1 digit */
   
     if (digit > 0)                  /* Display decimal point if there is more space on 7-SEG */
     {
         number = decimal / 1000;
-        i2c_write(_7SEG, digit, numberlookup[number]);
+        digits[digit] = numberlookup[number];
         digit--;
     }
 
     if (digit > 0)                 /* Display "c" if there is more space on 7-SEG */
     {
-        i2c_write(_7SEG, digit, 0x58);
+        digits[digit] = 0x58;
         digit--;
     }
   
-    if (digit > 0)                 /* Clear the rest of the digit */
-    {
-        i2c_write(_7SEG, digit, 0x00);
-    }
+    /* Digits 1 - 4 in one go, rather than a transaction per digit */
+    i2c_write_buf(_7SEG, 1, &digits[1], 4);
 }
 
 void update_rgb(uint8_t temp_h)
@@ -30,6 +30,7 @@
 #include "sys/eod_io.h"
 #include "sys/uart.h"
 #include "sys/util.h"
+#include "sys/clock.h"
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -48,28 +49,15 @@
 
 #ifdef _M8OD
 
-#ifdef _80D_5MHZ_
-#define DELAY_READ 2
-#define DELAY_AD_HOLD 2
-#define DELAY_AD_HOLD_POST_VDD 38
-#define DELAY_WRITE 745
-#define DELAY_POST_WRITE 3340
-#define DELAY_POWER_WAIT 0x7FFF
-#else
-#define DELAY_READ 5
-#define DELAY_AD_HOLD 5
-#define DELAY_AD_HOLD_POST_VDD 81
-#define DELAY_WRITE 1495
-#define DELAY_POST_WRITE 6684
-#define DELAY_POWER_WAIT 0xFFFF
-#endif
-
-#define pgm_1702a_delay_read() delay_ncycles(DELAY_READ)
+/* Originally measured at 10MHz with delay_ncycles() */
+#define DELAY_POWER_WAIT_MS 118
+
+#define pgm_1702a_delay_read() delay_us(15)
 #define pgm_1702a_delay_ad_setup() delay_ncycles(1)
-#define pgm_1702a_delay_ad_hold() delay_ncycles(DELAY_AD_HOLD)
-#define pgm_1702a_delay_ad_hold_post_vdd() delay_ncycles(DELAY_AD_HOLD_POST_VDD)
-#define pgm_1702a_delay_write() delay_ncycles(DELAY_WRITE)
-#define pgm_1702a_delay_post_write() delay_ncycles(DELAY_POST_WRITE)
+#define pgm_1702a_delay_ad_hold() delay_us(15)
+#define pgm_1702a_delay_ad_hold_post_vdd() delay_us(150)
+#define pgm_1702a_delay_write() delay_us(2700)
+#define pgm_1702a_delay_post_write() delay_ms(12)
 
 #define pgm_1702a_pen_enable()  cpld_write(CTRL_PORT, C1702A_PEN, C1702A_PEN)
 #define pgm_1702a_pen_disable() cpld_write(CTRL_PORT, C1702A_PEN, 0)
@@ -156,7 +144,7 @@ static void pgm_1702a_write_power_on()
     {
 #ifdef _M8OD
         cpld_write(CTRL_PORT, C1702A_PGMPWREN, C1702A_PGMPWREN);
-        delay_ncycles(DELAY_POWER_WAIT);
+        delay_ms(DELAY_POWER_WAIT_MS);
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -223,9 +211,9 @@ static void pgm_1702a_do_reset(void)
         pgm_1702a_pen_disable();
         cpld_write(CTRL_PORT, (C1702A_PGMPWREN), 0);
         // Wait for high voltage supplies to discharge
-        delay_ncycles(DELAY_POWER_WAIT);
-        delay_ncycles(DELAY_POWER_WAIT);
-        delay_ncycles(DELAY_POWER_WAIT);
+        delay_ms(DELAY_POWER_WAIT_MS);
+        delay_ms(DELAY_POWER_WAIT_MS);
+        delay_ms(DELAY_POWER_WAIT_MS);
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -253,8 +241,8 @@ static void pgm_1702a_do_reset(void)
 #ifdef _M8OD
         pgm_1702a_ren_disable();
         cpld_write(CTRL_PORT, (C1702A_READPWREN), 0);
-        delay_ncycles(DELAY_POWER_WAIT);
-        delay_ncycles(DELAY_POWER_WAIT);
+        delay_ms(DELAY_POWER_WAIT_MS);
+        delay_ms(DELAY_POWER_WAIT_MS);
 #endif /* _M8OD */
 
 #ifdef _MDUINO
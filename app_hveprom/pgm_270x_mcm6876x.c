@@ -31,6 +31,7 @@
 #include "sys/eod_io.h"
 #include "sys/uart.h"
 #include "sys/util.h"
+#include "sys/clock.h"
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -47,21 +48,14 @@
 
 #ifdef _M8OD
 
-#ifdef _80D_5MHZ_
-#define DELAY_WRITE_MCM6876X 430
-#define DELAY_WRITE_270X 260
-#define DELAY_POWER_WAIT 0x7FFF
-#else
-#define DELAY_WRITE_MCM6876X 870
-#define DELAY_WRITE_270X 535
-#define DELAY_POWER_WAIT 0xFFFF
-#endif
+/* Originally measured at 10MHz with delay_ncycles() */
+#define DELAY_POWER_WAIT_MS 118
 
 #define pgm_270x_mcm6876x_delay_read() delay_ncycles(1)
 #define pgm_270x_mcm6876x_delay_ad_setup() delay_ncycles(1)
 #define pgm_270x_mcm6876x_delay_ad_hold() delay_ncycles(1)
-#define pgm_270x_mcm6876x_delay_write_mcm6876x() delay_ncycles(DELAY_WRITE_MCM6876X)
-#define pgm_270x_mcm6876x_delay_write_270x() delay_ncycles(DELAY_WRITE_270X)
+#define pgm_270x_mcm6876x_delay_write_mcm6876x() delay_us(1570)
+#define pgm_270x_mcm6876x_delay_write_270x() delay_ms(1)
 #define pgm_270x_mcm6876x_wr_h_enable() cpld_write(CTRL_PORT, MCMX_270X_WR_H, MCMX_270X_WR_H)
 #define pgm_270x_mcm6876x_wr_h_disable() cpld_write(CTRL_PORT, MCMX_270X_WR_H, 0)
 #define pgm_270x_mcm6876x_rd_enable() cpld_write(CTRL_PORT, MCMX_270X_RD, MCMX_270X_RD)
@@ -254,7 +248,7 @@ void pgm_270x_mcm6876x_power_on()
 {
 #ifdef _M8OD
     cpld_write(CTRL_PORT, MCMX_270X_PON, MCMX_270X_PON);
-    delay_ncycles(DELAY_POWER_WAIT);
+    delay_ms(DELAY_POWER_WAIT_MS);
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -280,7 +274,7 @@ void pgm_270x_mcm6876x_reset(void)
         pgm_270x_mcm6876x_tms2716_set_vpp_state(VPP_STATE_0V);
 
 #ifdef _M8OD
-    delay_ncycles(DELAY_POWER_WAIT);
+    delay_ms(DELAY_POWER_WAIT_MS);
     cpld_write(CTRL_PORT, MCMX_270X_PON, 0); /* Power off */
 #endif /* _M8OD */
 
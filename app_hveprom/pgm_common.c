@@ -30,6 +30,7 @@
 #include "sys/eod_io.h"
 #include "sys/uart.h"
 #include "sys/adc.h"
+#include "sys/dsp.h"
 #include "sys/util.h"
 #endif /* _M8OD */
 
@@ -258,9 +259,14 @@ static void pgm_test_read(void)
         cmd_respond(CMD_TEST_READ, ERR_NO_DEV);
 }
 
+#ifdef _M8OD
+/* See pgm_measure_12v(). The extra 4 is for the 2 bits gained by oversampling */
+static const dsp_scale_t _g_12vScale = DSP_SCALE_INIT(806, 1803UL * 4);
+#endif /* _M8OD */
+
 static void pgm_measure_12v(void)
 {
-    uint32_t reading;
+    uint16_t reading;
 
 #ifdef _DEBUG
     printf("pgm_measure_12v()\r\n");
@@ -281,10 +287,11 @@ static void pgm_measure_12v(void)
      * 0.180327868852459 * 10000 = 1803.27868852459
      * 1000000 / 10000 = 100
      * Therefore: Result = Vin * 100
+     *
+     * 16 samples are decimated to one 14-bit sample, then the above
+     * is done as a single 16-bit multiply by 65536 * 806 / (1803 * 4).
      */
-    reading = adc_read_channel(0);
-    reading *= 806;
-    reading /= 1803;
+    reading = dsp_scale(&_g_12vScale, dsp_oversample(adc_read_channel, 0, 2));
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -30,6 +30,7 @@
 #include "sys/eod_io.h"
 #include "sys/uart.h"
 #include "sys/util.h"
+#include "sys/clock.h"
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -46,24 +47,13 @@
 
 #ifdef _M8OD
 
-#ifdef _80D_5MHZ_
-#define DELAY_PRE_READ      1
-#define DELAY_4TCY          2
-#define DELAY_WRITE         13925
-#define DELAY_PRE_POST_VDD  260
-#define DELAY_POWER_WAIT    0x7FFF
-#else
-#define DELAY_PRE_READ      2
-#define DELAY_4TCY          4
-#define DELAY_WRITE         27850
-#define DELAY_PRE_POST_VDD  535
-#define DELAY_POWER_WAIT    0xFFFF
-#endif
-
-#define pgm_mcs48_delay_4tcy() delay_ncycles(DELAY_4TCY)
-#define pgm_mcs48_delay_write() delay_ncycles(DELAY_WRITE)
-#define pgm_mcs48_delay_pre_read() delay_ncycles(DELAY_PRE_READ)
-#define pgm_mcs48_delay_pre_post_vdd() delay_ncycles(DELAY_PRE_POST_VDD)
+/* Originally measured at 10MHz with delay_ncycles() */
+#define DELAY_POWER_WAIT_MS 118
+
+#define pgm_mcs48_delay_4tcy() delay_us(13)
+#define pgm_mcs48_delay_write() delay_ms(50)
+#define pgm_mcs48_delay_pre_read() delay_us(10)
+#define pgm_mcs48_delay_pre_post_vdd() delay_ms(1)
 
 #define pgm_mcs48_pwr_up1_enable() cpld_write(CTRL_TRIS, MCS48_PWR_UP1, 0)
 #define pgm_mcs48_pwr_up1_disable() cpld_write(CTRL_TRIS, MCS48_PWR_UP1, MCS48_PWR_UP1)
@@ -261,7 +251,7 @@ void pgm_mcs48_power_on()
 
     cpld_write(CTRL_PORT, MCS48_PON, MCS48_PON);
 
-    delay_ncycles(DELAY_POWER_WAIT);
+    delay_ms(DELAY_POWER_WAIT_MS);
 #endif /* _M8OD */
 
 #ifdef _MDUINO
@@ -296,7 +286,7 @@ void pgm_mcs48_reset(void)
         pgm_mcs48_8755_reset_or_ale_enable();
 
 #ifdef _M8OD
-    delay_ncycles(DELAY_POWER_WAIT);
+    delay_ms(DELAY_POWER_WAIT_MS);
     cpld_write(CTRL_PORT, MCS48_PON, 0); /* Power off */
 #endif /* _M8OD */
 
@@ -26,132 +26,172 @@
 #include "eod_io.h"
 #include "uart.h"
 #include "adc.h"
-
-uint16_t _g_intflags = 0;
+#include "irq.h"
+#include "systime.h"
+#include "sched.h"
 
 char _g_a_rxChar;
 char _g_b_rxChar;
 char _g_c_rxChar;
 char _g_d_rxChar;
 
+/* Events for input_task() */
 #define FLG_PORTA_08_HIGH    0x001
 #define FLG_PORTA_09_HIGH    0x002
 #define FLG_PORTA_10_HIGH    0x004
 #define FLG_PORTA_11_HIGH    0x008
 #define FLG_EXTERNAL_INTA    0x010
 #define FLG_EXTERNAL_INTB    0x020
-#define FLG_UARTA_RX         0x040
-#define FLG_UARTB_RX         0x080
-#define FLG_UARTC_RX         0x100
-#define FLG_UARTD_RX         0x200
-#define FLG_TIMER_ELAPSED    0x400
 
-/* Higher number = shorter period */
-#define TIMER_RELOAD         0x0000
+/* Events for uart_task() */
+#define FLG_UARTA_RX         0x001
+#define FLG_UARTB_RX         0x002
+#define FLG_UARTC_RX         0x004
+#define FLG_UARTD_RX         0x008
+
+#define TIMER_PERIOD_MS      400
+#define STATS_PERIOD_MS      10000
+
+sched_task_t _g_inputTask;
+sched_task_t _g_uartTask;
+sched_task_t _g_timerTask;
+sched_task_t _g_statsTask;
 
 void interrupt_handler(void)
 {
-    /* Read status register (contains interrupt flags) */
-    uint16_t status = cpld_read(STATUS);
-
-    if (status & STATUS_PORTAF)
-    {
-        uint16_t porta = cpld_read(PORTA);
-
-        /* Clear the PORTA interrupt flag
-         *
-         * The correct procedure for clearing interrupt flags
-         * is to write a pattern containing all 1's, except the
-         * bit wanting to be cleared. The CPLD ignores 1's written
-         * to STATUS, so this practise doesn't end up creating
-         * artificial interrupts, nor does it accidentially clear
-         * anything that hasn't yet been flagged for processing.
-         *
-         * This ensures anything that interrupts occuring while
-         * this code is running instantly generate another interrupt
-         * when this function returns.
-         */
-        cpld_direct_write(STATUS, ~STATUS_PORTAF);
-
-        if (porta & (1 << 8))
-            _g_intflags |= FLG_PORTA_08_HIGH;
-
-        if (porta & (1 << 9))
-            _g_intflags |= FLG_PORTA_09_HIGH;
-
-        if (porta & (1 << 10))
-            _g_intflags |= FLG_PORTA_10_HIGH;
-
-        if (porta & (1 << 11))
-            _g_intflags |= FLG_PORTA_11_HIGH;
-    }
-
-    if (status & STATUS_EXTINTA)
-    {
-        _g_intflags |= FLG_EXTERNAL_INTA;
-
-        /* Clear the External interrupt flag */
-        cpld_direct_write(STATUS, ~STATUS_EXTINTA);
-    }
-
-    if (status & STATUS_EXTINTB)
-    {
-        _g_intflags |= FLG_EXTERNAL_INTB;
-
-        /* Clear the External interrupt flag */
-        cpld_direct_write(STATUS, ~STATUS_EXTINTB);
-    }
-
-    if (status & STATUS_UARTAF)
-    {
-        _g_intflags |= FLG_UARTA_RX;
-        _g_a_rxChar = uart_blocking_getc(UARTA);
-
-        /* UARTs clear their own interrupt flags */
-    }
-
-    if (status & STATUS_UARTBF)
-    {
-        _g_intflags |= FLG_UARTB_RX;
-        _g_b_rxChar = uart_blocking_getc(UARTB);
-    }
-
-    if (status & STATUS_UARTCF)
-    {
-        _g_intflags |= FLG_UARTC_RX;
-        _g_c_rxChar = uart_blocking_getc(UARTC);
-    }
-
-    if (status & STATUS_UARTDF)
-    {
-        _g_intflags |= FLG_UARTD_RX;
-        _g_d_rxChar = uart_blocking_getc(UARTD);
-    }
-
-    if (status & STATUS_TMF)
-    {
-        _g_intflags |= FLG_TIMER_ELAPSED;
-        /* Stop timer */
-        cpld_write(CONFIG, CONFIG_TMRUN, 0);
-        /* Reload timer */
-        cpld_direct_write(TIMER, TIMER_RELOAD);
-        /* Clear the timer flag */
-        cpld_direct_write(STATUS, ~STATUS_TMF);
-        /* Start timer */
-        cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
-    }
+    irq_dispatch();
 }
 
-void main(void)
+/*   irq_dispatch() clears each STATUS flag before calling its handler.
+ *
+ *   The correct procedure for clearing interrupt flags is to write a
+ *   pattern containing all 1's, except the bits wanting to be cleared.
+ *   The CPLD ignores 1's written to STATUS, so this practise doesn't end
+ *   up creating artificial interrupts, nor does it accidentially clear
+ *   anything that hasn't yet been flagged for processing.
+ *
+ *   This ensures anything that interrupts occuring while the handler
+ *   is running instantly generate another interrupt when it returns.
+ *
+ *   The handlers do no more than pass the event on to a task.
+ */
+void porta_interrupt(void)
 {
-    uint16_t t8 = 0;
-    uint16_t t9 = 0;
-    uint16_t t10 = 0;
-    uint16_t t11 = 0;
-    uint16_t exta = 0;
-    uint16_t extb = 0;
-    uint16_t tmnum = 0;
+    uint16_t porta = cpld_read(PORTA);
+    uint16_t events = 0;
 
+    if (porta & (1 << 8))
+        events |= FLG_PORTA_08_HIGH;
+
+    if (porta & (1 << 9))
+        events |= FLG_PORTA_09_HIGH;
+
+    if (porta & (1 << 10))
+        events |= FLG_PORTA_10_HIGH;
+
+    if (porta & (1 << 11))
+        events |= FLG_PORTA_11_HIGH;
+
+    if (events)
+        sched_post(&_g_inputTask, events);
+}
+
+void extinta_interrupt(void)
+{
+    sched_post(&_g_inputTask, FLG_EXTERNAL_INTA);
+}
+
+void extintb_interrupt(void)
+{
+    sched_post(&_g_inputTask, FLG_EXTERNAL_INTB);
+}
+
+/* UARTs clear their own interrupt flags */
+void uarta_interrupt(void)
+{
+    _g_a_rxChar = uart_blocking_getc(UARTA);
+    sched_post(&_g_uartTask, FLG_UARTA_RX);
+}
+
+void uartb_interrupt(void)
+{
+    _g_b_rxChar = uart_blocking_getc(UARTB);
+    sched_post(&_g_uartTask, FLG_UARTB_RX);
+}
+
+void uartc_interrupt(void)
+{
+    _g_c_rxChar = uart_blocking_getc(UARTC);
+    sched_post(&_g_uartTask, FLG_UARTC_RX);
+}
+
+void uartd_interrupt(void)
+{
+    _g_d_rxChar = uart_blocking_getc(UARTD);
+    sched_post(&_g_uartTask, FLG_UARTD_RX);
+}
+
+void input_task(uint16_t events, void *arg)
+{
+    static uint16_t t8 = 0;
+    static uint16_t t9 = 0;
+    static uint16_t t10 = 0;
+    static uint16_t t11 = 0;
+    static uint16_t exta = 0;
+    static uint16_t extb = 0;
+
+    if (events & FLG_PORTA_08_HIGH)
+        printf("Button attached to PORTA/08 pressed %u times\r\n", t8++);
+
+    if (events & FLG_PORTA_09_HIGH)
+        printf("Button attached to PORTA/09 pressed %u times\r\n", t9++);
+
+    if (events & FLG_PORTA_10_HIGH)
+        printf("Button attached to PORTA/10 pressed %u times\r\n", t10++);
+
+    if (events & FLG_PORTA_11_HIGH)
+        printf("Button attached to PORTA/11 pressed %u times\r\n", t11++);
+
+    if (events & FLG_EXTERNAL_INTA)
+        printf("External interrupt PORTA/2 asserted %u times\r\n", exta++);
+
+    if (events & FLG_EXTERNAL_INTB)
+        printf("External interrupt PORTA/3 asserted %u times\r\n", extb++);
+}
+
+void uart_task(uint16_t events, void *arg)
+{
+    if (events & FLG_UARTA_RX)
+        printf("UARTA received char: %c\r\n", _g_a_rxChar);
+
+    if (events & FLG_UARTB_RX)
+        printf("UARTB received char: %c\r\n", _g_b_rxChar);
+
+    if (events & FLG_UARTC_RX)
+        printf("UARTC received char: %c\r\n", _g_c_rxChar);
+
+    if (events & FLG_UARTD_RX)
+        printf("UARTD received char: %c\r\n", _g_d_rxChar);
+}
+
+void timer_task(uint16_t events, void *arg)
+{
+    static uint16_t tmnum = 0;
+
+    printf("Timer elapsed %u times\r\n", tmnum++);
+}
+
+void stats_task(uint16_t events, void *arg)
+{
+    sched_dump();
+    sched_reset_stats();
+
+    irq_dump();
+    irq_reset_stats();
+}
+
+void main(void)
+{
     uart_open(UARTA, 115200, 8, PARITY_NONE, 1, 1);
     uart_open(UARTB, 115200, 8, PARITY_NONE, 1, 1);
     uart_open(UARTC, 115200, 8, PARITY_NONE, 1, 1);
@@ -159,88 +199,34 @@ void main(void)
 
     setup_printf(UARTA);
 
+    sched_init();
+    sched_add(&_g_inputTask, "input", input_task, NULL, 0);
+    sched_add(&_g_uartTask, "uart", uart_task, NULL, 0);
+    sched_add(&_g_timerTask, "timer", timer_task, NULL, 0);
+    sched_add(&_g_statsTask, "stats", stats_task, NULL, 0);
+
+    irq_register(STATUS_PORTAF, porta_interrupt);
+    irq_register(STATUS_UARTAF, uarta_interrupt);
+    irq_register(STATUS_UARTBF, uartb_interrupt);
+    irq_register(STATUS_UARTCF, uartc_interrupt);
+    irq_register(STATUS_UARTDF, uartd_interrupt);
+    irq_register(STATUS_EXTINTA, extinta_interrupt);
+    irq_register(STATUS_EXTINTB, extintb_interrupt);
+    irq_stats_enable(1);
+
     /* Set 8, 9, 10, 11 and 2, 3 (EXTINTA and EXTINTB) of PORTA as inputs */
     cpld_write(TRISA, 0x0F0C, 0x0F0C);
 
-    /* Enable interrupts */
+    /* Enable interrupts. systime_init() enables the timer's. */
     cpld_write(CONFIG, CONFIG_GINT | CONFIG_PORTAINT | CONFIG_EXTINTA | CONFIG_EXTINTB | CONFIG_UAINT
-        | CONFIG_UBINT | CONFIG_UCINT | CONFIG_UDINT | CONFIG_TMINT,
+        | CONFIG_UBINT | CONFIG_UCINT | CONFIG_UDINT,
         CONFIG_GINT | CONFIG_PORTAINT | CONFIG_EXTINTA | CONFIG_EXTINTB | CONFIG_UAINT | 
-        CONFIG_UBINT | CONFIG_UCINT | CONFIG_UDINT | CONFIG_TMINT);
-
-    /* Load timer */
-    cpld_direct_write(TIMER, TIMER_RELOAD);
-    /* Start timer */
-    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
-
-    while (1)
-    {
-        if (_g_intflags & FLG_PORTA_08_HIGH)
-        {
-            printf("Button attached to PORTA/08 pressed %u times\r\n", t8++);
-            _g_intflags &= ~FLG_PORTA_08_HIGH;
-        }
-
-        if (_g_intflags & FLG_PORTA_09_HIGH)
-        {
-            printf("Button attached to PORTA/09 pressed %u times\r\n", t9++);
-            _g_intflags &= ~FLG_PORTA_09_HIGH;
-        }
-
-        if (_g_intflags & FLG_PORTA_10_HIGH)
-        {
-            printf("Button attached to PORTA/10 pressed %u times\r\n", t10++);
-            _g_intflags &= ~FLG_PORTA_10_HIGH;
-        }
-
-        if (_g_intflags & FLG_PORTA_11_HIGH)
-        {
-            printf("Button attached to PORTA/11 pressed %u times\r\n", t11++);
-            _g_intflags &= ~FLG_PORTA_11_HIGH;
-        }
-
-        if (_g_intflags & FLG_EXTERNAL_INTA)
-        {
-            printf("External interrupt PORTA/2 asserted %u times\r\n", exta++);
-            _g_intflags &= ~FLG_EXTERNAL_INTA;
-        }
-
-        if (_g_intflags & FLG_EXTERNAL_INTB)
-        {
-            printf("External interrupt PORTA/3 asserted %u times\r\n", extb++);
-            _g_intflags &= ~FLG_EXTERNAL_INTB;
-        }
-
-        if (_g_intflags & FLG_UARTA_RX)
-        {
-            printf("UARTA received char: %c\r\n", _g_a_rxChar);
-            _g_intflags &= ~FLG_UARTA_RX;
-        }
-
-        if (_g_intflags & FLG_UARTB_RX)
-        {
-            printf("UARTB received char: %c\r\n", _g_b_rxChar);
-            _g_intflags &= ~FLG_UARTB_RX;
-        }
-
-        if (_g_intflags & FLG_UARTC_RX)
-        {
-            printf("UARTC received char: %c\r\n", _g_c_rxChar);
-            _g_intflags &= ~FLG_UARTC_RX;
-        }
-
-        if (_g_intflags & FLG_UARTD_RX)
-        {
-            printf("UARTD received char: %c\r\n", _g_d_rxChar);
-            _g_intflags &= ~FLG_UARTD_RX;
-        }
-
-        if (_g_intflags & FLG_TIMER_ELAPSED)
-        {
-            printf("Timer elapsed %u times\r\n", tmnum++);
-            _g_intflags &= ~FLG_TIMER_ELAPSED;
-        }
-    }
-}
+        CONFIG_UBINT | CONFIG_UCINT | CONFIG_UDINT);
+
+    systime_init();
 
+    sched_sleep(&_g_timerTask, TIMER_PERIOD_MS, TIMER_PERIOD_MS);
+    sched_sleep(&_g_statsTask, STATS_PERIOD_MS, STATS_PERIOD_MS);
 
+    sched_run();
+}
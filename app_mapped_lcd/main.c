@@ -28,8 +28,6 @@
 #include "uart.h"
 #include "util.h"
 
-void marquee_line(const char *text, int line);
-
 const char *line0 = "abcdefghijklmnopqrstuvwxyz";
 const char *line1 = "ABCDEFGHIJKLMNOPQRSTUVWXYZ";
 const char *line2 = "123456789012345678901234567890";
@@ -41,36 +39,10 @@ void interrupt_handler(void)
     /* Unused */
 }
 
-void marquee_line(const char *text, int line)
-{
-    uint16_t remaining;
-    char buf[41];
-
-    remaining = 40;
-    buf[40] = 0;
-
-    while(1)
-    {
-        uint16_t linelen = strlen(text);
-        remaining--;
-        
-        memset(buf, ' ', 40);
-        memcpy(buf + remaining, text, linelen > (40 - remaining) ?
-            (40 - remaining) : linelen);
-
-        lcd_pos(line, 0);
-        lcd_string(buf);
-
-        delay_ncycles(20000);
-
-        if (remaining == 0)
-            break;
-    }
-}
-
 void main(void)
 {
     int i = 0;
+    int step;
     
     uart_open(UARTA, 115200, 8, PARITY_NONE, 1, 0);
     setup_printf(UARTA);
@@ -83,9 +55,16 @@ void main(void)
         printf("Hello world %u\r\n", i++);
         delay_ncycles(65535);
     
-        marquee_line(line0, 0);
-        marquee_line(line1, 1);
-        marquee_line(line2, 2);
-        marquee_line(line3, 3);
+        lcd_scroll_text(0, line0);
+        lcd_scroll_text(1, line1);
+        lcd_scroll_text(2, line2);
+        lcd_scroll_text(3, line3);
+
+        /* All the way round once */
+        for (step = 0; step < LCD_COLS; step++)
+        {
+            lcd_scroll_step(LCD_ROW_ALL);
+            delay_ncycles(20000);
+        }
     }
 }
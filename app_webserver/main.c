@@ -28,15 +28,22 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
-#include <malloc.h>
 #include <ctype.h>
 
 #include "eod_io.h"
+#include "eod_map.h"
 #include "lcd_io.h"
 #include "uart.h"
-#include "lcd.h"
 #include "util.h"
 #include "httputil.h"
+#include "spiflash.h"
+#include "blkdev.h"
+#include "packfs.h"
+#include "systime.h"
+#include "sched.h"
+#include "prof.h"
+#include "pool.h"
+#include "farheap.h"
 #include "w5100.h"
 #include "webserver.h"
 
@@ -45,24 +52,53 @@
 #define debug_printf(...) printf(__VA_ARGS__)
 #define error_printf(...) printf(__VA_ARGS__)
 
-#define MAX_BUF      8912
 #define LINE_LEN     40
 #define LINE_COUNT   4
 
+/* Static content image (built with tools/mkpackfs) lives at the bottom
+ * of the SPI flash, below the boot area.
+ */
+#define CONTENT_OFFSET  0x00000
+#define CONTENT_LINES   16
+
+/* Uncomment to find out where the time goes. Send 'p' on the console
+ * to dump the histogram for tools/profsym, 'r' to clear it.
+ */
+//#define PROFILE
+
 static void add_message(char *name, char *message);
 static void update_lcd(void);
 static void send_index(uint8_t sock);
 static void send_404(uint8_t sock);
+static int send_file(uint8_t instance, const char *filename);
 
 static void http_post(uint8_t instance, char *filename, char *header, char *request);
 static void http_get(uint8_t instance, char *filename, char *header);
 static void http_response_sent(uint8_t instance);
+static void ws_task(uint16_t events, void *arg);
+static void lcd_task(uint16_t events, void *arg);
+#ifdef PROFILE
+static void prof_task(uint16_t events, void *arg);
+#endif
 
 char *_g_lcdLines[LINE_COUNT];
 
-#define RFLG_UPDATE_LCD     0x01
+/* Message lines come and go with every post, so have a pool of their own */
+pool_t _g_linePool;
+uint16_t _g_lineMem[POOL_MEM_WORDS(LINE_LEN + 1, LINE_COUNT)];
+
+/* lcd_task() events */
+#define EV_UPDATE_LCD       0x01
 
-uint8_t _g_runFlags;
+sched_task_t _g_wsTask;
+sched_task_t _g_lcdTask;
+#ifdef PROFILE
+sched_task_t _g_profTask;
+#endif
+
+blkdev_t _g_flashCache;
+packfs_t _g_content;
+uint8_t _g_contentMounted;
 
 void main(void)
 {
@@ -76,16 +112,18 @@ void main(void)
     for (i = 0; i < LINE_COUNT; i++)
         _g_lcdLines[i] = NULL;
 
+    pool_init(&_g_linePool, "lcd lines", _g_lineMem, LINE_LEN + 1, LINE_COUNT);
+
     cpld_write(PORTA, (1 << 10), (1 << 10)); //ETH CS High
     cpld_write(TRISA, (1 << 10), 0); //PIN 10 Output (ETH CS)
 
     /* Set Bit 2 (EXTINTA) of PORTA as input */
     cpld_write(TRISA, (1 << 2), (1 << 2));
 
-    /* Enable interrupts globally, and enable the external interrupt A (on GFP2)
-     * which is negative logic, and the ethernet shield happens to be connected to
+    /* Enable interrupts globally. ws_init() enables its own sources once
+     * it has registered their handlers.
      */
-    cpld_write(CONFIG, (CONFIG_GINT | CONFIG_EXTINTA | CONFIG_TMINT), (CONFIG_GINT | CONFIG_EXTINTA | CONFIG_TMINT));
+    cpld_write(CONFIG, CONFIG_GINT, CONFIG_GINT);
 
 #if 0
     SET4(w5100config.ip_addr, 81, 187, 233, 78); /* Spare public IP address - incendiary.inaxeon.co.uk */
@@ -101,30 +139,71 @@ void main(void)
 
     w5100_init(&w5100config);
 
-    _g_runFlags = 0;
+    _g_contentMounted = blkdev_init(&_g_flashCache, &spi_ops, BLK_LINE_256, CONTENT_LINES,
+            farheap_alloc_seg((uint32_t)BLK_LINE_256 * CONTENT_LINES), 0) &&
+        packfs_mount(&_g_content, &_g_flashCache, CONTENT_OFFSET);
+
+    if (!_g_contentMounted)
+        printf("No static content image found in SPI flash\r\n");
 
     lcd_init();
+    /* LCD bytes go out from the main loop, between servicing sockets */
+    lcd_set_async(1);
 
     ws_config.port = 80;
     ws_config.http_post = &http_post;
     ws_config.http_get = &http_get;
     ws_config.http_response_sent = &http_response_sent;
 
+    /* Socket timeouts run off this */
+    systime_init();
+
     ws_init(&ws_config);
 
-    for (;;)
+    /* Both poll hardware, so run on every pass. Add other tasks here. */
+    sched_init();
+    sched_add(&_g_wsTask, "webserver", ws_task, NULL, SCHED_POLL);
+    sched_add(&_g_lcdTask, "lcd", lcd_task, NULL, SCHED_POLL);
+
+#ifdef PROFILE
+    /* Samples on the systime tick */
+    if (prof_init(farheap_alloc_seg(PROF_SIZE)))
     {
-        ws_process();
+        sched_add(&_g_profTask, "prof", prof_task, NULL, SCHED_POLL);
+        prof_start();
+    }
+#endif
 
-        if (_g_runFlags & RFLG_UPDATE_LCD)
-        {
-            _g_runFlags &= ~RFLG_UPDATE_LCD;
-            update_lcd();
-        }
+    sched_run();
+}
 
-        /* Do other stuff here */
-    }
+static void ws_task(uint16_t events, void *arg)
+{
+    ws_process();
+}
+
+static void lcd_task(uint16_t events, void *arg)
+{
+    if (events & EV_UPDATE_LCD)
+        update_lcd();
+
+    lcd_poll();
+}
+
+#ifdef PROFILE
+static void prof_task(uint16_t events, void *arg)
+{
+    char c;
+
+    if (!uart_getc(UARTA, &c))
+        return;
+
+    if (c == 'p')
+        prof_dump(UARTA);
+    else if (c == 'r')
+        prof_reset();
 }
+#endif
 
 static void http_post(uint8_t instance, char *filename, char *header, char *request)
 {
@@ -147,13 +226,14 @@ static void http_post(uint8_t instance, char *filename, char *header, char *requ
 
 static void http_get(uint8_t instance, char *filename, char *header)
 {
-    if (stricmp(filename, "/"))
+    if (!stricmp(filename, "/"))
     {
-        send_404(instance);
+        send_index(instance);
         return;
     }
 
-    send_index(instance);
+    if (!send_file(instance, filename))
+        send_404(instance);
 }
 
 static void http_response_sent(uint8_t instance)
@@ -178,20 +258,20 @@ static void add_message(char *name, char *message)
     if (!*name || !*message)
         return;
 
-    if (_g_lcdLines[3])
-        free(_g_lcdLines[3]);
+    /* Oldest line goes first, so there are never more than LINE_COUNT */
+    pool_free(&_g_linePool, _g_lcdLines[LINE_COUNT - 1]);
 
     for (i = (LINE_COUNT - 2); i >= 0; i--)
         _g_lcdLines[i + 1] = _g_lcdLines[i];
 
-    _g_lcdLines[0] = malloc(LINE_LEN + 1);
+    _g_lcdLines[0] = pool_alloc(&_g_linePool);
 
     /* Truncate what's left from the name len from the message */
     message[LINE_LEN - 2 - strlen(name)] = '\0';
 
     sprintf(_g_lcdLines[0], "%s: %s", name, message);
 
-    _g_runFlags |= RFLG_UPDATE_LCD;
+    sched_post(&_g_lcdTask, EV_UPDATE_LCD);
 }
 
 #define IDT0 "    "
@@ -284,63 +364,120 @@ static void add_message(char *name, char *message)
     IDT1 "</form>\r\n"
 
 
+#define INDEX_TOP \
+    "HTTP/1.0 200 OK\r\n" \
+    "Content-type: text/html\r\n\r\n" \
+    HEAD \
+    INDEX1
+
+#define INDEX_BOTTOM \
+    INDEX2 \
+    TAIL
+
+/* <ol>, every message as an <li>, and </ol> */
+#define INDEX_LIST_LEN  ((LINE_COUNT * (LINE_LEN + 32)) + 48)
+
+/* The fixed parts go straight from the string constants, so only the
+ * messages have to be put together on the stack.
+ */
 static void send_index(uint8_t instance)
 {
     int i;
-    int sendsize;
-    char buf[MAX_BUF];
-    char line[128];
-
-    strcpy(buf, "HTTP/1.0 200 OK\r\n");
-    strcat(buf, "Content-type: text/html\r\n\r\n");
-
-    strcat(buf, HEAD);
-    strcat(buf, INDEX1);
+    uint16_t sendsize;
+    char list[INDEX_LIST_LEN];
+    char *pos = list;
 
     if (_g_lcdLines[0] != NULL)
-        strcat(buf, IDT2 "<ol>\r\n");
+        pos += sprintf(pos, IDT2 "<ol>\r\n");
 
     for (i = 0; i < LINE_COUNT; i++)
     {
         if (_g_lcdLines[i])
-        {
-            sprintf(line, IDT3 "<li>%s</li>\r\n", _g_lcdLines[i]);
-            strcat(buf, line);
-        }
+            pos += sprintf(pos, IDT3 "<li>%s</li>\r\n", _g_lcdLines[i]);
     }
 
     if (_g_lcdLines[0] != NULL)
-        strcat(buf, IDT2 "</ol>\r\n");
+        pos += sprintf(pos, IDT2 "</ol>\r\n");
 
-    strcat(buf, INDEX2);
-    strcat(buf, TAIL);
+    sendsize = ws_send(instance, INDEX_TOP, sizeof(INDEX_TOP) - 1);
+    sendsize += ws_send(instance, list, pos - list);
+    sendsize += ws_send(instance, INDEX_BOTTOM, sizeof(INDEX_BOTTOM) - 1);
 
-    sendsize = strlen(buf);
     debug_printf("Index page size: %u\r\n", sendsize);
-    ws_send(instance, buf, sendsize);
 }
 
 static void send_404(uint8_t sock)
 {
-    uint8_t buf[MAX_BUF];
+    const char *response = "HTTP/1.0 404 Not Found\r\n\r\n";
+
+    ws_send(sock, response, strlen(response));
+}
+
+static const char *content_type(const char *filename)
+{
+    const char *ext = strrchr(filename, '.');
+
+    if (!ext)
+        return "application/octet-stream";
+
+    if (!stricmp(ext, ".html") || !stricmp(ext, ".htm"))
+        return "text/html";
+    if (!stricmp(ext, ".css"))
+        return "text/css";
+    if (!stricmp(ext, ".js"))
+        return "application/javascript";
+    if (!stricmp(ext, ".png"))
+        return "image/png";
+    if (!stricmp(ext, ".jpg"))
+        return "image/jpeg";
+    if (!stricmp(ext, ".gif"))
+        return "image/gif";
+    if (!stricmp(ext, ".ico"))
+        return "image/x-icon";
+    if (!stricmp(ext, ".txt"))
+        return "text/plain";
+
+    return "application/octet-stream";
+}
+
+static int send_file(uint8_t instance, const char *filename)
+{
+    packfs_file_t file;
+    char header[128];
+
+    if (!_g_contentMounted || !packfs_open(&_g_content, filename, &file))
+        return 0;
 
-    strcpy(buf, "HTTP/1.0 404 Not Found\r\n\r\n");
+    sprintf(header, "HTTP/1.0 200 OK\r\nContent-type: %s\r\nContent-Length: %lu\r\n\r\n",
+        content_type(filename), file.length);
 
-    ws_send(sock, buf, strlen(buf));
+    debug_printf("File size: %lu\r\n", file.length);
+
+    ws_send(instance, header, strlen(header));
+
+    /* A graceful close would pass a short body off as the whole file */
+    if (ws_send_file(instance, &_g_content, &file) != file.length)
+    {
+        debug_printf("send_file(%u): Short send, aborting\r\n", instance);
+        ws_abort(instance);
+    }
+
+    return 1;
 }
 
 static void update_lcd(void)
 {
     int line;
 
-    lcd_clear01();
-    lcd_clear23();
+    /* Only what's changed since the last update gets sent */
+    lcd_fb_clear();
 
     for (line = 0; line < LINE_COUNT; line++)
     {
-        lcd_pos(line, 0);
         if (_g_lcdLines[line])
-            lcd_string(_g_lcdLines[line]);
+            lcd_fb_write(line, 0, _g_lcdLines[line]);
     }
+
+    lcd_flush();
 }
 
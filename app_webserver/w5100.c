@@ -24,6 +24,7 @@
 
 #include "eod_io.h"
 #include "util.h"
+#include "clock.h"
 #include "mid.h"
 #include "w5100.h"
 
@@ -74,9 +75,17 @@
 
 uint8_t _g_imr;
 
+/* PORTA is only written from the main loop, so the chip select doesn't
+ * need cpld_write_atomic()
+ */
+/*   Interrupts are masked with ETH CS low, as well as by mid.c for the
+ *   transfer itself, so nothing else (e.g. adccap) clocks the MID while
+ *   the W5100 is selected.
+ */
 void w5100_write(unsigned int addr, uint8_t data)
 {
     uint8_t toSend[4];
+    uint16_t gint = cpld_int_disable();
 
     cpld_write(PORTA, (1 << 10), 0); /* ETH CS Low */
 
@@ -88,12 +97,15 @@ void w5100_write(unsigned int addr, uint8_t data)
     mid_xfer_x8(M_DEV_SPARE1, 4, &toSend, 0, NULL);
     
     cpld_write(PORTA, (1 << 10), (1 << 10)); /* ETH CS High */
+
+    cpld_int_restore(gint);
 }
 
 uint8_t w5100_read(unsigned int addr)
 {
     uint8_t ret;
     uint8_t toSend[3];
+    uint16_t gint = cpld_int_disable();
 
     cpld_write(PORTA, (1 << 10), 0); /* ETH CS Low */
 
@@ -105,6 +117,8 @@ uint8_t w5100_read(unsigned int addr)
 
     cpld_write(PORTA, (1 << 10), (1 << 10)); /* ETH CS High */
 
+    cpld_int_restore(gint);
+
     return ret;
 }
 
@@ -115,7 +129,7 @@ void w5100_init(w5100_config_t *config)
     /* Setting the Wiznet w5100 Mode Register: 0x0000 */
     w5100_write(MR, 0x80);
 
-    delay_ncycles(554); /* 1ms */
+    delay_ms(1);
 
     debug_printf("Reading MR: %d\r\n\r\n", w5100_read(MR));
 
@@ -132,7 +146,7 @@ void w5100_init(w5100_config_t *config)
     w5100_write(GAR + 2, config->gw_addr[2]);
     w5100_write(GAR + 3, config->gw_addr[3]);
 
-    delay_ncycles(554); /* 1ms */
+    delay_ms(1);
 
     debug_printf("Reading GAR: %d.%d.%d.%d\r\n\r\n",
         w5100_read(GAR + 0),
@@ -156,7 +170,7 @@ void w5100_init(w5100_config_t *config)
     w5100_write(SAR + 4, config->mac_addr[4]);
     w5100_write(SAR + 5, config->mac_addr[5]);
     
-    delay_ncycles(554); /* 1ms */
+    delay_ms(1);
     
     debug_printf("Reading SAR: %.2x:%.2x:%.2x:%.2x:%.2x:%.2x\r\n\r\n",
         w5100_read(SAR + 0),
@@ -179,7 +193,7 @@ void w5100_init(w5100_config_t *config)
     w5100_write(SUBR + 2, config->sub_mask[2]);
     w5100_write(SUBR + 3, config->sub_mask[3]);
 
-    delay_ncycles(554); /* 1ms */
+    delay_ms(1);
     
     debug_printf("Reading SUBR: %d.%d.%d.%d\r\n\r\n",
         w5100_read(SUBR + 0),
@@ -199,7 +213,7 @@ void w5100_init(w5100_config_t *config)
     w5100_write(SIPR + 2, config->ip_addr[2]);
     w5100_write(SIPR + 3, config->ip_addr[3]);
     
-    delay_ncycles(554); /* 1ms */
+    delay_ms(1);
 
     debug_printf("Reading SIPR: %d.%d.%d.%d\r\n\r\n",
         w5100_read(SIPR + 0),
@@ -283,17 +297,18 @@ uint8_t w5100_listen(uint8_t sock)
     return retval;
 }
 
-uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen)
+/* Wait for room for len bytes in the socket's TX buffer, and return
+ * the current write pointer in *ptr. Data is then copied in with
+ * w5100_tx_write() as many times as needed, and finally sent by
+ * w5100_tx_commit(). This lets callers fill the TX buffer piecemeal
+ * from wherever the data comes from, without staging it all in RAM.
+ */
+uint8_t w5100_tx_begin(uint8_t sock, uint16_t len, uint16_t *ptr)
 {
-    uint16_t ptr;
-    uint16_t offaddr;
     uint16_t txsize;
-    uint16_t timeout;   
+    uint16_t timeout;
 
-    if (buflen == 0)
-        return 0;
-
-    debug_printf("Send Size: %d\r\n",buflen);
+    debug_printf("Send Size: %d\r\n", len);
 
     /* Make sure the TX Free Size Register is available */
     txsize = w5100_read(SADDR_OF(Sx_TX_FSR, sock));
@@ -302,9 +317,9 @@ uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen)
     debug_printf("TX Free Size: %d\r\n",txsize);
 
     timeout = 0;
-    while (txsize < buflen)
+    while (txsize < len)
     {
-        delay_ncycles(554); /* 1ms */
+        delay_ms(1);
         txsize = w5100_read(SADDR_OF(Sx_TX_FSR, sock));
         txsize = (((txsize & 0x00FF) << 8 ) + w5100_read(SADDR_OF(Sx_TX_FSR, sock) + 1));
         
@@ -319,14 +334,21 @@ uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen)
     }    
 
     /* Read the Tx Write Pointer */
-    ptr = w5100_read(SADDR_OF(Sx_TX_WR, sock));
-    offaddr = (((ptr & 0x00FF) << 8 ) + w5100_read(SADDR_OF(Sx_TX_WR, sock) + 1));
+    *ptr = w5100_read(SADDR_OF(Sx_TX_WR, sock));
+    *ptr = (((*ptr & 0x00FF) << 8 ) + w5100_read(SADDR_OF(Sx_TX_WR, sock) + 1));
+
+    debug_printf("TX Buffer: %x\r\n", *ptr);
+
+    return 1;
+}
 
-    debug_printf("TX Buffer: %x\r\n", offaddr);
+void w5100_tx_write(uint8_t sock, uint16_t *ptr, const uint8_t *buf, uint16_t len)
+{
+    uint16_t offaddr = *ptr;
 
-    while (buflen)
+    while (len)
     {
-        buflen--;
+        len--;
         /* Calculate the real w5100 physical Tx Buffer Address */
         /* Copy the application data to the w5100 Tx Buffer */
         w5100_write(BADDR_OF(TXBUFADDR, sock) + (offaddr & TX_BUF_MASK), *buf);
@@ -334,12 +356,31 @@ uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen)
         buf++;
     }
 
+    *ptr = offaddr;
+}
+
+void w5100_tx_commit(uint8_t sock, uint16_t ptr)
+{
     /* Increase the S0_TX_WR value, so it point to the next transmit */
-    w5100_write(SADDR_OF(Sx_TX_WR, sock),     (offaddr & 0xFF00) >> 8);
-    w5100_write(SADDR_OF(Sx_TX_WR, sock) + 1, (offaddr & 0x00FF));    
+    w5100_write(SADDR_OF(Sx_TX_WR, sock),     (ptr & 0xFF00) >> 8);
+    w5100_write(SADDR_OF(Sx_TX_WR, sock) + 1, (ptr & 0x00FF));    
 
     /* Now Send the SEND command */
     w5100_write(SADDR_OF(Sx_CR, sock), CR_SEND);
+}
+
+uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen)
+{
+    uint16_t ptr;
+
+    if (buflen == 0)
+        return 0;
+
+    if (!w5100_tx_begin(sock, buflen, &ptr))
+        return 0;
+
+    w5100_tx_write(sock, &ptr, buf, buflen);
+    w5100_tx_commit(sock, ptr);
 
     return 1;
 }
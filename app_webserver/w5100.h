@@ -107,6 +107,9 @@ uint8_t w5100_get_sock_intflags(uint8_t sock);
 uint8_t w5100_socket(uint8_t sock, uint8_t eth_protocol, uint16_t tcp_port);
 uint8_t w5100_listen(uint8_t sock);
 uint16_t w5100_send(uint8_t sock, const uint8_t *buf, uint16_t buflen);
+uint8_t w5100_tx_begin(uint8_t sock, uint16_t len, uint16_t *ptr);
+void w5100_tx_write(uint8_t sock, uint16_t *ptr, const uint8_t *buf, uint16_t len);
+void w5100_tx_commit(uint8_t sock, uint16_t ptr);
 uint16_t w5100_recv(uint8_t sock, char *buf, uint16_t buflen);
 uint16_t w5100_rx_buffer_length(uint8_t sock);
 
@@ -27,9 +27,12 @@
 
 #include "util.h"
 #include "mid.h"
+#include "packfs.h"
 #include "w5100.h"
 #include "webserver.h"
 #include "eod_io.h"
+#include "irq.h"
+#include "systime.h"
 
 #define STATE_DEBUG 
 #define ACTIVITY_DEBUG
@@ -41,9 +44,11 @@
 #endif
 
 #define MAX_BUF                 2048
+#define MAX_TX_SEGMENT          2048    /* Size of each socket's W5100 TX buffer */
+#define FILE_CHUNK              256
 #define MAX_SOCKS               4
-#define MAX_SOCK_TIMEOUT_INTRS  300     /* Timeout after 30s */
-#define TIMER_RELOAD            0xC000  /* Approx 100ms */
+#define MAX_SOCK_TIMEOUT_TICKS  300     /* Timeout after 30s */
+#define WS_TICK_MS              100
 
 /* Web specific server socket states */
 #define WS_DISCONNECTED        0
@@ -57,7 +62,7 @@
 #define RQ_REQUEST_RECEIVED    3
 #define RQ_REQUEST_PROCESSED   4
 
-/* Flags which come from the interrupt handler */
+/* Flags which come from the interrupt handler and timers */
 #define FLG_W5100_INTR         0x01
 #define FLG_SOCK_TIMEOUT       0x02
 #define FLG_IP_CONFLICT        0x04
@@ -86,69 +91,62 @@ static void sock_restart(uint8_t sock);
 static void sock_connected(uint8_t sock);
 static void sock_disconnect(uint8_t sock);
 static void sock_data_received(uint8_t sock);
+static void ws_w5100_interrupt(void);
+static void ws_tick(void *arg);
 
 inline void process_timeouts(void);
 inline void process_incoming_connection_intrs(void);
 inline void process_socks(void);
 
+static systime_timer_t _g_wsTimer;
+
 #ifdef STATE_DEBUG
-#define MAX_DEBUG_TIMEOUT_INTRS 100     /* 10s */
-uint16_t _g_debugTimeoutInts;
+#define DEBUG_INTERVAL_MS       10000
+systime_timer_t _g_debugTimer;
 uint16_t _g_debugSequence;
 inline void process_state_debug(void);
+static void ws_debug_lapsed(void *arg);
 #endif
 
 void interrupt_handler(void)
 {
-    /* Read status register (contains interrupt flags) */
-    uint16_t status = cpld_read(STATUS);
+    irq_dispatch();
+}
 
-    /* W5100's interrupt */
-    if (status & STATUS_EXTINTA)
-    {
-        _g_intflags |= FLG_W5100_INTR;
+/* W5100's interrupt */
+static void ws_w5100_interrupt(void)
+{
+    _g_intflags |= FLG_W5100_INTR;
 
-        /* Mask it, because we can't make it go away right now */
-        cpld_write(CONFIG, CONFIG_EXTINTA, 0);
-    }
+    /* Mask it, because we can't make it go away right now */
+    cpld_write(CONFIG, CONFIG_EXTINTA, 0);
+}
 
-    /* Timer overflow interrupt */
-    if (status & STATUS_TMF)
+/* Every WS_TICK_MS, from systime_process() */
+static void ws_tick(void *arg)
+{
+    int i;
+    for (i = 0; i < MAX_SOCKS; i++)
     {
-        int i;
-        for (i = 0; i < MAX_SOCKS; i++)
-        {
-            if (_g_ws_instances[i].state == WS_CONNECTED)
-                _g_ws_instances[i].request_timeout++;
+        if (_g_ws_instances[i].state == WS_CONNECTED)
+            _g_ws_instances[i].request_timeout++;
 
-            if (_g_ws_instances[i].request_timeout >= MAX_SOCK_TIMEOUT_INTRS)
-            {
-                _g_ws_instances[i].request_timeout = 0;
-                _g_ws_instances[i].timedout = 1;
+        if (_g_ws_instances[i].request_timeout >= MAX_SOCK_TIMEOUT_TICKS)
+        {
+            _g_ws_instances[i].request_timeout = 0;
+            _g_ws_instances[i].timedout = 1;
 
-                _g_intflags |= FLG_SOCK_TIMEOUT;
-            }
+            _g_intflags |= FLG_SOCK_TIMEOUT;
         }
+    }
+}
 
 #ifdef STATE_DEBUG
-        _g_debugTimeoutInts++;
-        if (_g_debugTimeoutInts >= MAX_DEBUG_TIMEOUT_INTRS)
-        {
-            _g_intflags |= FLG_TIMER_LAPSED;
-            _g_debugTimeoutInts = 0;
-        }
-#endif
-
-        /* Stop timer */
-        cpld_write(CONFIG, CONFIG_TMRUN, 0);
-        /* Reload timer */
-        cpld_direct_write(TIMER, TIMER_RELOAD);
-        /* Clear the timer flag */
-        cpld_direct_write(STATUS, ~STATUS_TMF);
-        /* Start timer */
-        cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
-    }
+static void ws_debug_lapsed(void *arg)
+{
+    _g_intflags |= FLG_TIMER_LAPSED;
 }
+#endif
 
 /* Web server idle process */
 void ws_process(void)
@@ -228,7 +226,7 @@ inline void process_incoming_connection_intrs(void)
         _g_intflags &= ~FLG_W5100_INTR;
 
         /* Unmask and clear */
-        cpld_write(CONFIG, CONFIG_EXTINTA, CONFIG_EXTINTA);
+        cpld_write_atomic(CONFIG, CONFIG_EXTINTA, CONFIG_EXTINTA);
         cpld_direct_write(STATUS, ~STATUS_EXTINTA);
     }
 }
@@ -358,7 +356,6 @@ void ws_init(ws_t *ws)
     _g_intflags = 0;
 
 #ifdef STATE_DEBUG
-    _g_debugTimeoutInts = 0;
     _g_debugSequence = 0;
 #endif
 
@@ -367,10 +364,21 @@ void ws_init(ws_t *ws)
     for (sock = 0; sock < MAX_SOCKS; sock++)
         _g_ws_instances[sock].state = WS_DISCONNECTED;
 
-    /* Load timer */
-    cpld_direct_write(TIMER, TIMER_RELOAD);
-    /* Start timer */
-    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
+    irq_register(STATUS_EXTINTA, ws_w5100_interrupt);
+
+    /* External interrupt A (on GFP2) is negative logic, and the
+     * ethernet shield happens to be connected to it
+     */
+    cpld_write_atomic(CONFIG, CONFIG_EXTINTA, CONFIG_EXTINTA);
+
+    /* systime_init() must have been called already */
+    systime_timer_init(&_g_wsTimer, ws_tick, NULL);
+    systime_timer_start(&_g_wsTimer, WS_TICK_MS, WS_TICK_MS);
+
+#ifdef STATE_DEBUG
+    systime_timer_init(&_g_debugTimer, ws_debug_lapsed, NULL);
+    systime_timer_start(&_g_debugTimer, DEBUG_INTERVAL_MS, DEBUG_INTERVAL_MS);
+#endif
 }
 
 void ws_disconnect(uint8_t instance)
@@ -378,6 +386,12 @@ void ws_disconnect(uint8_t instance)
     w5100_disconnect(instance);
 }
 
+/* Drops the connection without a FIN, e.g. when a response got cut short */
+void ws_abort(uint8_t instance)
+{
+    w5100_close(instance);
+}
+
 uint16_t ws_send(uint8_t instance, const uint8_t *buf, uint16_t buflen)
 {
     int written = 0;
@@ -393,6 +407,38 @@ uint16_t ws_send(uint8_t instance, const uint8_t *buf, uint16_t buflen)
     return written;
 }
 
+/* Streams a file from flash straight into the W5100 TX buffer,
+ * FILE_CHUNK bytes at a time, so it never has to fit in RAM.
+ */
+uint32_t ws_send_file(uint8_t instance, packfs_t *fs, packfs_file_t *file)
+{
+    uint8_t chunk[FILE_CHUNK];
+    uint32_t written = 0;
+
+    while (file->pos < file->length)
+    {
+        uint32_t remaining = file->length - file->pos;
+        uint16_t segment = remaining > MAX_TX_SEGMENT ? MAX_TX_SEGMENT : (uint16_t)remaining;
+        uint16_t ptr;
+
+        if (!w5100_tx_begin(instance, segment, &ptr))
+            break;
+
+        written += segment;
+
+        while (segment > 0)
+        {
+            uint16_t thisRead = packfs_read(fs, file, chunk, segment > FILE_CHUNK ? FILE_CHUNK : segment);
+            w5100_tx_write(instance, &ptr, chunk, thisRead);
+            segment -= thisRead;
+        }
+
+        w5100_tx_commit(instance, ptr);
+    }
+
+    return written;
+}
+
 static int do_request(uint8_t sock)
 {
     int i;
@@ -21,6 +21,8 @@
 #ifndef __WEBSERVER_H__
 #define __WEBSERVER_H__
 
+#include "packfs.h"
+
 typedef struct
 {
     int port;
@@ -31,8 +33,10 @@ typedef struct
 
 void ws_interrupt(void);
 uint16_t ws_send(uint8_t instance, const uint8_t *buf, uint16_t buflen);
+uint32_t ws_send_file(uint8_t instance, packfs_t *fs, packfs_file_t *file);
 void ws_init(ws_t *ws);
 void ws_process(void);
 void ws_disconnect(uint8_t instance);
+void ws_abort(uint8_t instance);
 
 #endif /* __WEBSERVER_H__ */
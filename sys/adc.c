@@ -23,6 +23,7 @@
 #include "eod_map.h"
 #include "eod_io.h"
 #include "mid.h"
+#include "boot.h"
 #include "adc.h"
 
 #define CTRL_WRITE      (1 << 7)
@@ -37,35 +38,159 @@
 
 #define CTRL_ADD_SHIFT  2
 
+static boot_drv_t _g_adcDrv = BOOT_DRV("adc", adc_init);
+
 void adc_init(void)
 {
+    boot_started(&_g_adcDrv);
+
     mid_cfg_dev(M_DEV_ADC, 1, M_CLK_DPOSEDGE, M_D_16BIT);
+    mid_default_speed_hz(M_DEV_ADC, M_DEV_ADC_MAX_HZ);
 }
 
-uint16_t adc_read_channel(int channel)
+/* One 16-bit frame. Returns whatever was converted during it */
+static uint16_t adc_frame(uint8_t ctrl_h, uint8_t ctrl_l)
 {
     uint16_t value;
 
     outp(MID_BASE + CSEL, ~(1 << M_DEV_ADC));
 
-    outp(MID_BASE + SMB, CTRL_WEAKTRI | CTRL_RANGE | CTRL_CODING);
-    outp(MID_BASE + FMB_CS0SEL + M_DEV_ADC, (CTRL_WRITE | CTRL_PM1 | CTRL_PM0) | channel << CTRL_ADD_SHIFT);
-    
+    outp(MID_BASE + SMB, ctrl_l);
+    outp(MID_BASE + FMB_CS0SEL + M_DEV_ADC, ctrl_h);
+
     while ((inp(MID_BASE + ST) & ST_UWDONE) == 0);
 
+    value = (inp(MID_BASE + FMB) << 8) | inp(MID_BASE + SMB);
+
     outp(MID_BASE + CSEL, 0xFF);
-    outp(MID_BASE + CSEL, ~(1 << M_DEV_ADC));
 
-    outp(MID_BASE + SMB, CTRL_RANGE | CTRL_CODING);
-    outp(MID_BASE + FMB_CS0SEL + M_DEV_ADC, (CTRL_WRITE | CTRL_PM1 | CTRL_PM0) | channel << CTRL_ADD_SHIFT);
+    return value;
+}
 
-    while ((inp(MID_BASE + ST) & ST_UWDONE) == 0);
+/*   Everything here masks interrupts for the whole exchange, as mid.c
+ *   does, so a conversion from adccap's interrupt can't land between
+ *   frames.
+ */
+uint16_t adc_read_channel(int channel)
+{
+    uint16_t value;
+    uint16_t gint;
 
-    value = (inp(MID_BASE + FMB) << 8) | inp(MID_BASE + SMB);
+    boot_require(_g_adcDrv);
 
-    outp(MID_BASE + CSEL, 0xFF);
+    gint = cpld_int_disable();
+
+    mid_apply_speed(M_DEV_ADC);
+
+    /* Select the channel, then convert it */
+    adc_frame((CTRL_WRITE | CTRL_PM1 | CTRL_PM0) | channel << CTRL_ADD_SHIFT, CTRL_WEAKTRI | CTRL_RANGE | CTRL_CODING);
+    value = adc_frame((CTRL_WRITE | CTRL_PM1 | CTRL_PM0) | channel << CTRL_ADD_SHIFT, CTRL_RANGE | CTRL_CODING);
+
+    cpld_int_restore(gint);
 
     value &= 0xFFF;
                      
     return value;
 }
+
+/*   Sequencer mode
+ *
+ *   The channel mask is written to the AD7490's shadow register once,
+ *   after which every frame sent with WRITE clear converts the next
+ *   channel in the mask, wrapping back around to the lowest. Each result
+ *   carries its channel number in the top 4 bits, so there's no need to
+ *   keep track of where in the sequence we are.
+ *
+ *   The shadow register is only loaded by the frame after one with
+ *   SEQ = 0 and SHADOW = 1. SEQ = 1 and SHADOW = 1 means something else
+ *   entirely: convert channels 0 to ADD in turn.
+ *
+ *   Any call to adc_read_channel() ends the sequence.
+ */
+static uint8_t _g_seqLen;
+static uint16_t _g_seqMask;
+
+/*   Returns 0 if the mask is empty, or the channels that came back
+ *   from a first pass weren't all in it.
+ */
+int adc_seq_start(uint16_t mask)
+{
+    uint16_t shadow = 0;
+    uint16_t gint;
+    int ret = 1;
+    int i;
+
+    boot_require(_g_adcDrv);
+
+    if (!mask)
+        return 0;
+
+    /* Shadow register has VIN0 in the MSB */
+    _g_seqLen = 0;
+    for (i = 0; i < 16; i++)
+    {
+        if (mask & (1 << i))
+        {
+            shadow |= 0x8000 >> i;
+            _g_seqLen++;
+        }
+    }
+
+    _g_seqMask = mask;
+
+    gint = cpld_int_disable();
+
+    mid_apply_speed(M_DEV_ADC);
+
+    adc_frame(CTRL_WRITE | CTRL_PM1 | CTRL_PM0, CTRL_SHADOW | CTRL_RANGE | CTRL_CODING);
+    adc_frame(shadow >> 8, shadow & 0xFF);
+
+    /* Make sure it took. A whole pass leaves it back where it started. */
+    for (i = 0; i < _g_seqLen; i++)
+    {
+        if (!(mask & (1 << ADC_SEQ_CHANNEL(adc_frame(0x00, 0x00)))))
+            ret = 0;
+    }
+
+    cpld_int_restore(gint);
+
+    return ret;
+}
+
+/* Next conversion in the sequence. Channel in bits 12-15 */
+uint16_t adc_seq_next(void)
+{
+    uint16_t value;
+    uint16_t gint = cpld_int_disable();
+
+    mid_apply_speed(M_DEV_ADC);
+    value = adc_frame(0x00, 0x00);
+
+    cpld_int_restore(gint);
+
+    return value;
+}
+
+/* One pass over every channel in the mask, results[channel] = level */
+void adc_seq_scan(uint16_t *results)
+{
+    uint16_t gint;
+    uint8_t i;
+
+    boot_require(_g_adcDrv);
+
+    gint = cpld_int_disable();
+
+    mid_apply_speed(M_DEV_ADC);
+
+    for (i = 0; i < _g_seqLen; i++)
+    {
+        uint16_t value = adc_frame(0x00, 0x00);
+
+        /* Never write to a channel the caller didn't ask for */
+        if (_g_seqMask & (1 << ADC_SEQ_CHANNEL(value)))
+            results[ADC_SEQ_CHANNEL(value)] = ADC_SEQ_LEVEL(value);
+    }
+
+    cpld_int_restore(gint);
+}
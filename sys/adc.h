@@ -20,5 +20,15 @@
 
 #define ADC_MAX_LEVEL       0xFFF
 
+#define ADC_NUM_CHANNELS    16
+
+/* Splits up the results of adc_seq_next() */
+#define ADC_SEQ_CHANNEL(x)  ((x) >> 12)
+#define ADC_SEQ_LEVEL(x)    ((x) & ADC_MAX_LEVEL)
+
 void adc_init(void);
 uint16_t adc_read_channel(int channel);
+
+int adc_seq_start(uint16_t mask);
+uint16_t adc_seq_next(void);
+void adc_seq_scan(uint16_t *results);
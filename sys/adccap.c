@@ -0,0 +1,264 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Timer paced ADC capture
+ *
+ *   Each TIMER overflow converts every channel in the mask once, using
+ *   the AD7490's sequencer, and appends the results to a ring buffer in
+ *   far RAM. The main loop drains the ring at its leisure, either as
+ *   plain 12-bit levels or packed two samples to three bytes for
+ *   sending out over a UART.
+ *
+ *   The capture owns TIMER while it's running, registering
+ *   adccap_interrupt() for STATUS_TMF with irq.c, so the app's
+ *   interrupt_handler() must call irq_dispatch().
+ *
+ *   Converting from the interrupt means using the MID from the
+ *   interrupt. mid.c and adc.c mask interrupts for each transfer, but a
+ *   driver that selects its device some other way (e.g. a GPIO chip
+ *   select, as w5100.c does) has to mask them for as long as it's
+ *   selected too, or it will see the ADC's frames.
+ *
+ *   As with every other user of TIMER, it's stopped and reloaded from
+ *   the interrupt, so each period is stretched by however long the
+ *   interrupt took to get there, more so if a UART interrupt was being
+ *   handled at the time. TIMER can't be read back, so that jitter can't
+ *   be timestamped. A sweep is only lost when the ring is full, which is
+ *   counted as an overrun.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <i86.h>
+#include "eod_io.h"
+#include "eod_map.h"
+#include "adc.h"
+#include "uart.h"
+#include "adccap.h"
+#include "irq.h"
+
+static uint16_t far *_g_ring;
+static uint16_t _g_ringMask;
+static volatile uint16_t _g_head;   /* Written by the interrupt only */
+static volatile uint16_t _g_tail;   /* Written by the main loop only */
+static uint16_t _g_reload;
+static uint8_t _g_sweepLen;
+static adccap_stats_t _g_stats;
+
+#define adccap_used() ((_g_head - _g_tail) & _g_ringMask)
+
+/* num_samples must be a power of two. One slot is always left empty. */
+int adccap_init(uint16_t seg, uint16_t num_samples)
+{
+    if (!num_samples || num_samples > ADCCAP_MAX_SAMPLES || (num_samples & (num_samples - 1)))
+        return 0;
+
+    if (seg < FAR_RAM_SEG || ((uint32_t)(seg - FAR_RAM_SEG) << 4) + ((uint32_t)num_samples << 1) > FAR_RAM_SIZE)
+        return 0;
+
+    _g_ring = (uint16_t far *)MK_FP(seg, 0);
+    _g_ringMask = num_samples - 1;
+    _g_head = 0;
+    _g_tail = 0;
+
+    adccap_reset_stats();
+
+    return 1;
+}
+
+/*   Starts capturing every channel in mask, hz times a second.
+ *
+ *   Returns the rate actually achieved by the TIMER divider.
+ *   0 if hz is out of range, or the ADC didn't take the channel mask.
+ */
+uint32_t adccap_start(uint16_t mask, uint32_t hz)
+{
+    uint32_t ticks;
+    int i;
+
+    if (!_g_ring || !mask || !hz || hz > TIMER_HZ)
+        return 0;
+
+    /* Nearest whole number of ticks */
+    ticks = (TIMER_HZ + (hz >> 1)) / hz;
+
+    if (ticks > 0xFFFF)
+        return 0;
+
+    _g_sweepLen = 0;
+    for (i = 0; i < ADC_NUM_CHANNELS; i++)
+    {
+        if (mask & (1 << i))
+            _g_sweepLen++;
+    }
+
+    adccap_stop();
+
+    if (!adc_seq_start(mask))
+        return 0;
+
+    _g_reload = (uint16_t)(0x10000UL - ticks);
+    _g_head = 0;
+    _g_tail = 0;
+
+    cpld_direct_write(TIMER, _g_reload);
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+    irq_register(STATUS_TMF, adccap_interrupt);
+    cpld_write_atomic(CONFIG, CONFIG_TMINT | CONFIG_TMRUN, CONFIG_TMINT | CONFIG_TMRUN);
+
+    return TIMER_HZ / ticks;
+}
+
+void adccap_stop(void)
+{
+    cpld_write_atomic(CONFIG, CONFIG_TMINT | CONFIG_TMRUN, 0);
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+}
+
+/* Called from irq_dispatch() on STATUS_TMF, which has already cleared it */
+void adccap_interrupt(void)
+{
+    uint16_t used;
+    uint8_t i;
+
+    /* Re-arm first, to keep the period as close as possible */
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(TIMER, _g_reload);
+    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
+
+    _g_stats.sweeps++;
+
+    used = adccap_used();
+
+    if (_g_ringMask - used < _g_sweepLen)
+    {
+        _g_stats.overruns++;
+        return;
+    }
+
+    for (i = 0; i < _g_sweepLen; i++)
+    {
+        _g_ring[_g_head] = ADC_SEQ_LEVEL(adc_seq_next());
+        _g_head = (_g_head + 1) & _g_ringMask;
+    }
+
+    used += _g_sweepLen;
+
+    if (used > _g_stats.high_water)
+        _g_stats.high_water = used;
+}
+
+/* Samples waiting, always whole sweeps */
+uint16_t adccap_available(void)
+{
+    return adccap_used();
+}
+
+/* Levels come out in channel order within each sweep */
+uint16_t adccap_read(uint16_t *buf, uint16_t len)
+{
+    uint16_t avail = adccap_used();
+    uint16_t tail = _g_tail;
+    uint16_t i;
+
+    if (len > avail)
+        len = avail;
+
+    for (i = 0; i < len; i++)
+    {
+        buf[i] = _g_ring[tail];
+        tail = (tail + 1) & _g_ringMask;
+    }
+
+    _g_tail = tail;
+
+    return len;
+}
+
+/*   Packs up to len bytes worth of samples, two to every three bytes,
+ *   most significant bits first:
+ *
+ *   [a11..a4] [a3..a0 b11..b8] [b7..b0]
+ *
+ *   Returns the number of bytes written. Always a multiple of 3.
+ */
+uint16_t adccap_pack(uint8_t *buf, uint16_t len)
+{
+    uint16_t pairs = adccap_used() >> 1;
+    uint16_t tail = _g_tail;
+    uint16_t i;
+
+    if (pairs > len / 3)
+        pairs = len / 3;
+
+    for (i = 0; i < pairs; i++)
+    {
+        uint16_t a = _g_ring[tail];
+        uint16_t b = _g_ring[(tail + 1) & _g_ringMask];
+
+        *buf++ = (uint8_t)(a >> 4);
+        *buf++ = (uint8_t)((a << 4) | (b >> 8));
+        *buf++ = (uint8_t)b;
+
+        tail = (tail + 2) & _g_ringMask;
+    }
+
+    _g_tail = tail;
+
+    return pairs * 3;
+}
+
+/* Returns the number of samples sent */
+uint16_t adccap_stream_uart(int index, uint16_t max_samples)
+{
+    uint8_t packed[48];
+    uint16_t sent = 0;
+
+    while (sent < max_samples)
+    {
+        uint16_t room = ADCCAP_PACKED_LEN(max_samples - sent);
+        uint16_t len;
+        uint16_t i;
+
+        len = adccap_pack(packed, room < sizeof(packed) ? room : sizeof(packed));
+
+        if (!len)
+            break;
+
+        for (i = 0; i < len; i++)
+            uart_putc(index, packed[i]);
+
+        sent += (len / 3) << 1;
+    }
+
+    return sent;
+}
+
+void adccap_get_stats(adccap_stats_t *stats)
+{
+    /* Stop the interrupt changing them part way through the copy */
+    uint16_t gint = cpld_int_disable();
+    *stats = _g_stats;
+    cpld_int_restore(gint);
+}
+
+void adccap_reset_stats(void)
+{
+    _g_stats.sweeps = 0;
+    _g_stats.overruns = 0;
+    _g_stats.high_water = 0;
+}
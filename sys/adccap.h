@@ -0,0 +1,52 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Timer paced ADC capture
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ADCCAP_H__
+#define __ADCCAP_H__
+
+#include <stdint.h>
+
+/* Ring holds at most one 64K segment of 16-bit samples */
+#define ADCCAP_MAX_SAMPLES  0x8000
+
+/* Bytes adccap_pack() needs for n samples (n is rounded down to even) */
+#define ADCCAP_PACKED_LEN(n) (((n) >> 1) * 3)
+
+typedef struct
+{
+    uint32_t sweeps;        /* Timer ticks sampled */
+    uint32_t overruns;      /* Sweeps dropped because the ring was full */
+    uint16_t high_water;    /* Most samples ever waiting in the ring */
+} adccap_stats_t;
+
+int adccap_init(uint16_t seg, uint16_t num_samples);
+uint32_t adccap_start(uint16_t mask, uint32_t hz);
+void adccap_stop(void);
+void adccap_interrupt(void);
+
+uint16_t adccap_available(void);
+uint16_t adccap_read(uint16_t *buf, uint16_t len);
+uint16_t adccap_pack(uint8_t *buf, uint16_t len);
+uint16_t adccap_stream_uart(int index, uint16_t max_samples);
+
+void adccap_get_stats(adccap_stats_t *stats);
+void adccap_reset_stats(void);
+
+#endif /* __ADCCAP_H__ */
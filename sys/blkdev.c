@@ -0,0 +1,343 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Cached block device layer over flash_ops_t
+ *
+ *   Every spiflash_read() costs a status poll and a 4 byte command
+ *   before any data arrives, so lots of small scattered reads spend
+ *   most of their time on overhead. This keeps an LRU cache of whole
+ *   lines in far RAM, so only the first access to a line hits the
+ *   flash. Writes are held in the cache until blkdev_flush().
+ *
+ *   Dirty lines are written back with flash_update(), so writes can go
+ *   anywhere, erased or not. An erase block that needs erasing is
+ *   staged in far RAM (see farheap.c) while it's done.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <i86.h>
+#include "eod_map.h"
+#include "util.h"
+#include "flash.h"
+#include "blkdev.h"
+
+#define blkdev_line_ptr(bd, idx) \
+    ((uint8_t far *)MK_FP((bd)->seg + ((idx) * ((bd)->line_size >> 4)), 0))
+
+static void blkdev_touch(blkdev_t *bd, int idx)
+{
+    int i;
+
+    if (++bd->clock == 0)
+    {
+        /* Wrapped. Start everyone again from the bottom */
+        for (i = 0; i < bd->num_lines; i++)
+            bd->lines[i].age = 0;
+
+        bd->clock = 1;
+    }
+
+    bd->lines[idx].age = bd->clock;
+}
+
+static int blkdev_lookup(blkdev_t *bd, uint32_t tag)
+{
+    int i;
+
+    for (i = 0; i < bd->num_lines; i++)
+    {
+        if (bd->lines[i].tag == tag)
+            return i;
+    }
+
+    return -1;
+}
+
+/*   flash_update() only erases if the new data needs bits set that
+ *   the flash has cleared, and keeps the rest of the erase block. Any
+ *   other lines cached from that block still match the flash after.
+ */
+static int blkdev_writeback(blkdev_t *bd, int idx)
+{
+    blk_line_t *line = &bd->lines[idx];
+
+    if (!flash_update(bd->ops, line->tag + line->dirty_start, line->dirty_end - line->dirty_start,
+        blkdev_line_ptr(bd, idx) + line->dirty_start))
+    {
+        return 0;
+    }
+
+    line->dirty_start = 0;
+    line->dirty_end = 0;
+    bd->stats.writebacks++;
+
+    return 1;
+}
+
+static int blkdev_fill(blkdev_t *bd, uint32_t tag)
+{
+    uint8_t bounce[FLASH_WRITE_SIZE];
+    uint8_t far *dst;
+    uint16_t pos;
+    int victim = 0;
+    int i;
+
+    /* Empty lines first, otherwise the least recently used */
+    for (i = 0; i < bd->num_lines; i++)
+    {
+        if (bd->lines[i].tag == BLK_TAG_INVALID)
+        {
+            victim = i;
+            break;
+        }
+
+        if (bd->lines[i].age < bd->lines[victim].age)
+            victim = i;
+    }
+
+    if (bd->lines[victim].dirty_end && !blkdev_writeback(bd, victim))
+        return -1;
+
+    bd->lines[victim].tag = BLK_TAG_INVALID;
+
+    dst = blkdev_line_ptr(bd, victim);
+
+    for (pos = 0; pos < bd->line_size; pos += FLASH_WRITE_SIZE)
+    {
+        bd->ops->read(tag + pos, FLASH_WRITE_SIZE, bounce);
+        memcpy_far(dst + pos, bounce, FLASH_WRITE_SIZE);
+    }
+
+    bd->lines[victim].tag = tag;
+    blkdev_touch(bd, victim);
+
+    return victim;
+}
+
+static int blkdev_get_line(blkdev_t *bd, uint32_t tag)
+{
+    int idx = blkdev_lookup(bd, tag);
+    uint32_t next;
+
+    if (idx >= 0)
+    {
+        bd->stats.hits++;
+        blkdev_touch(bd, idx);
+        return idx;
+    }
+
+    bd->stats.misses++;
+
+    idx = blkdev_fill(bd, tag);
+
+    if (idx < 0)
+        return idx;
+
+    /* Two misses on consecutive lines looks like a sequential
+     * read, so fetch the one after as well while we're here.
+     */
+    next = tag + bd->line_size;
+
+    if ((bd->flags & BLK_READAHEAD) && bd->num_lines > 1 &&
+        bd->last_miss + bd->line_size == tag && next < bd->size &&
+        blkdev_lookup(bd, next) < 0)
+    {
+        if (blkdev_fill(bd, next) >= 0)
+            bd->stats.readaheads++;
+
+        /* Keep the line actually asked for the most recent */
+        blkdev_touch(bd, idx);
+    }
+
+    bd->last_miss = tag;
+
+    return idx;
+}
+
+int blkdev_init(blkdev_t *bd, const flash_ops_t *ops, uint16_t line_size, uint16_t num_lines, uint16_t seg, uint8_t flags)
+{
+    uint16_t block_data_len;
+    flash_erase_block_t *block_data;
+    uint32_t erase_size;
+    uint32_t boot_offset;
+    int i;
+
+    if (line_size != BLK_LINE_256 && line_size != BLK_LINE_4K)
+        return 0;
+
+    if (!num_lines || num_lines > BLK_MAX_LINES)
+        return 0;
+
+    /* Must all fit in far RAM */
+    if (seg < FAR_RAM_SEG ||
+        ((uint32_t)(seg - FAR_RAM_SEG) << 4) + ((uint32_t)line_size * num_lines) > FAR_RAM_SIZE)
+        return 0;
+
+    bd->ops = ops;
+    bd->seg = seg;
+    bd->line_size = line_size;
+    bd->num_lines = num_lines;
+    bd->clock = 0;
+    bd->flags = flags;
+    bd->last_miss = BLK_TAG_INVALID;
+    bd->size = ops->get_geometry(&block_data_len, &block_data, &erase_size, &boot_offset);
+
+    for (i = 0; i < num_lines; i++)
+    {
+        bd->lines[i].tag = BLK_TAG_INVALID;
+        bd->lines[i].age = 0;
+        bd->lines[i].dirty_start = 0;
+        bd->lines[i].dirty_end = 0;
+    }
+
+    blkdev_reset_stats(bd);
+
+    return 1;
+}
+
+/* 0 if any of it is past the end of the device */
+int blkdev_read(blkdev_t *bd, uint32_t offset, uint16_t len, uint8_t *buf)
+{
+    if ((offset + len) > bd->size)
+        return 0;
+
+    while (len)
+    {
+        uint16_t lineoff = (uint16_t)(offset & (bd->line_size - 1));
+        uint16_t chunk = bd->line_size - lineoff;
+        int idx;
+
+        if (chunk > len)
+            chunk = len;
+
+        idx = blkdev_get_line(bd, offset - lineoff);
+
+        if (idx < 0)
+        {
+            /* Couldn't free up a line. Go around the cache. */
+            bd->ops->read(offset, chunk, buf);
+        }
+        else
+        {
+            memcpy_far(buf, blkdev_line_ptr(bd, idx) + lineoff, chunk);
+        }
+
+        offset += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+
+    return 1;
+}
+
+int blkdev_write(blkdev_t *bd, uint32_t offset, uint16_t len, const uint8_t *buf)
+{
+    if ((offset + len) > bd->size)
+        return 0;
+
+    while (len)
+    {
+        uint16_t lineoff = (uint16_t)(offset & (bd->line_size - 1));
+        uint16_t chunk = bd->line_size - lineoff;
+        blk_line_t *line;
+        int idx;
+
+        if (chunk > len)
+            chunk = len;
+
+        idx = blkdev_get_line(bd, offset - lineoff);
+
+        if (idx < 0)
+            return 0;
+
+        line = &bd->lines[idx];
+        memcpy_far(blkdev_line_ptr(bd, idx) + lineoff, buf, chunk);
+
+        if (!line->dirty_end)
+        {
+            line->dirty_start = lineoff;
+            line->dirty_end = lineoff + chunk;
+        }
+        else
+        {
+            if (lineoff < line->dirty_start)
+                line->dirty_start = lineoff;
+            if (lineoff + chunk > line->dirty_end)
+                line->dirty_end = lineoff + chunk;
+        }
+
+        offset += chunk;
+        buf += chunk;
+        len -= chunk;
+    }
+
+    return 1;
+}
+
+int blkdev_flush(blkdev_t *bd)
+{
+    int ret = 1;
+    int i;
+
+    for (i = 0; i < bd->num_lines; i++)
+    {
+        if (bd->lines[i].dirty_end && !blkdev_writeback(bd, i))
+            ret = 0;
+    }
+
+    bd->ops->wait_write();
+
+    return ret;
+}
+
+/* Drop any cached lines covering the given range, dirty or not.
+ * Must be called after erasing underneath the cache.
+ */
+void blkdev_invalidate(blkdev_t *bd, uint32_t start, uint32_t len)
+{
+    int i;
+
+    for (i = 0; i < bd->num_lines; i++)
+    {
+        uint32_t tag = bd->lines[i].tag;
+
+        if (tag == BLK_TAG_INVALID)
+            continue;
+
+        if (tag + bd->line_size > start && tag < start + len)
+        {
+            bd->lines[i].tag = BLK_TAG_INVALID;
+            bd->lines[i].age = 0;
+            bd->lines[i].dirty_start = 0;
+            bd->lines[i].dirty_end = 0;
+        }
+    }
+
+    bd->last_miss = BLK_TAG_INVALID;
+}
+
+void blkdev_get_stats(blkdev_t *bd, blk_stats_t *stats)
+{
+    memcpy(stats, &bd->stats, sizeof(blk_stats_t));
+}
+
+void blkdev_reset_stats(blkdev_t *bd)
+{
+    memset(&bd->stats, 0, sizeof(blk_stats_t));
+}
@@ -0,0 +1,77 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Cached block device layer over flash_ops_t
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BLKDEV_H__
+#define __BLKDEV_H__
+
+#include <stdint.h>
+#include "flash.h"
+
+/* Supported cache line sizes */
+#define BLK_LINE_256        0x100
+#define BLK_LINE_4K         0x1000
+
+/* 64 x 4K lines fill the whole of far RAM */
+#define BLK_MAX_LINES       64
+
+#define BLK_TAG_INVALID     0xFFFFFFFFUL
+
+/* blkdev_init() flags */
+#define BLK_READAHEAD       0x01
+
+typedef struct
+{
+    uint32_t tag;           /* Flash offset of the line, or BLK_TAG_INVALID */
+    uint16_t age;           /* LRU stamp. Lowest is evicted first */
+    uint16_t dirty_start;   /* Dirty byte range within the line */
+    uint16_t dirty_end;     /* dirty_end == 0 means clean */
+} blk_line_t;
+
+typedef struct
+{
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t readaheads;
+    uint32_t writebacks;
+} blk_stats_t;
+
+typedef struct
+{
+    const flash_ops_t *ops;
+    uint16_t seg;           /* Far RAM segment holding the line data */
+    uint32_t size;          /* Device size, from get_geometry() */
+    uint16_t line_size;
+    uint16_t num_lines;
+    uint16_t clock;
+    uint8_t flags;
+    uint32_t last_miss;     /* Used to detect sequential access */
+    blk_stats_t stats;
+    blk_line_t lines[BLK_MAX_LINES];
+} blkdev_t;
+
+int blkdev_init(blkdev_t *bd, const flash_ops_t *ops, uint16_t line_size, uint16_t num_lines, uint16_t seg, uint8_t flags);
+int blkdev_read(blkdev_t *bd, uint32_t offset, uint16_t len, uint8_t *buf);
+int blkdev_write(blkdev_t *bd, uint32_t offset, uint16_t len, const uint8_t *buf);
+int blkdev_flush(blkdev_t *bd);
+void blkdev_invalidate(blkdev_t *bd, uint32_t start, uint32_t len);
+void blkdev_get_stats(blkdev_t *bd, blk_stats_t *stats);
+void blkdev_reset_stats(blkdev_t *bd);
+
+#endif /* __BLKDEV_H__ */
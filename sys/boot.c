@@ -0,0 +1,136 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   On demand driver start up
+ *
+ *   The boot timeline is only built with -dBOOT_TIMING. The bootrom
+ *   links the drivers, and so this, but has no printf().
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "boot.h"
+
+#ifdef BOOT_TIMING
+#include <stdio.h>
+#include "eod_io.h"
+#include "clock.h"
+
+typedef struct
+{
+    const char *name;
+    uint32_t us;
+    uint8_t flags;
+} boot_phase_t;
+
+static boot_phase_t _g_bootPhases[BOOT_MAX_PHASES];
+static uint8_t _g_bootNumPhases;
+static uint8_t _g_bootTiming;       /* Inside a timed init */
+#endif /* BOOT_TIMING */
+
+static boot_drv_t *_g_bootHead;
+static boot_drv_t *_g_bootTail;
+
+/* Called by each driver's init. Only the first call counts. */
+void boot_started(boot_drv_t *drv)
+{
+    if (drv->ready)
+        return;
+
+    drv->ready = 1;
+    drv->next = NULL;
+
+    if (_g_bootTail)
+        _g_bootTail->next = drv;
+    else
+        _g_bootHead = drv;
+
+    _g_bootTail = drv;
+}
+
+boot_drv_t *boot_drivers(void)
+{
+    return _g_bootHead;
+}
+
+#ifdef BOOT_TIMING
+
+void boot_phase(const char *name, uint32_t us, uint8_t flags)
+{
+    if (_g_bootNumPhases == BOOT_MAX_PHASES)
+        return;
+
+    _g_bootPhases[_g_bootNumPhases].name = name;
+    _g_bootPhases[_g_bootNumPhases].us = us;
+    _g_bootPhases[_g_bootNumPhases].flags = flags;
+    _g_bootNumPhases++;
+}
+
+/*   boot_require() with -dBOOT_TIMING. The stopwatch needs TIMER to
+ *   itself, so a driver first used once something has taken TIMER's
+ *   interrupt is listed, but not timed. Nor is one started from inside
+ *   another's init, which is counted in the outer one's time.
+ */
+void boot_timed_init(boot_drv_t *drv)
+{
+    uint32_t us;
+
+    if (_g_bootTiming || (cpld_shadow_read(CONFIG) & CONFIG_TMINT))
+    {
+        drv->init();
+        boot_phase(drv->name, 0, BOOT_UNTIMED);
+        return;
+    }
+
+    _g_bootTiming = 1;
+
+    clock_stopwatch_start();
+    drv->init();
+    us = clock_stopwatch_us();
+
+    _g_bootTiming = 0;
+
+    boot_phase(drv->name, us, us >= CLOCK_STOPWATCH_US ? BOOT_OVERRUN : 0);
+}
+
+/* In the order they happened, to stdout */
+void boot_dump(void)
+{
+    boot_drv_t *drv;
+    uint8_t i;
+
+    for (i = 0; i < _g_bootNumPhases; i++)
+    {
+        boot_phase_t *phase = &_g_bootPhases[i];
+
+        if (phase->flags & BOOT_UNTIMED)
+            printf("%-12s %8s  untimed\r\n", phase->name, "-");
+        else
+            printf("%-12s %c%7luus%s\r\n", phase->name,
+                (phase->flags & BOOT_OVERRUN) ? '>' : ' ', phase->us,
+                (phase->flags & BOOT_NOMINAL) ? " nominal" : "");
+    }
+
+    printf("Drivers started:");
+
+    for (drv = boot_drivers(); drv; drv = drv->next)
+        printf(" %s", drv->name);
+
+    printf("\r\n");
+}
+
+#endif /* BOOT_TIMING */
@@ -0,0 +1,68 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Boot timeline and on demand driver start up
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __BOOT_H__
+#define __BOOT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*   Drivers start themselves the first time they're used, rather than
+ *   all of them being started by _CMain() whether the app needs them
+ *   or not. Each has one of these, and its public entry points start
+ *   with boot_require(). Its own init function calls boot_started(), so
+ *   calling that directly (e.g. for a non-default speed) works too.
+ */
+typedef struct boot_drv
+{
+    const char *name;
+    void (*init)(void);
+    struct boot_drv *next;      /* In the order they started */
+    uint8_t ready;
+} boot_drv_t;
+
+#define BOOT_DRV(name, init)    { name, init, NULL, 0 }
+
+#ifdef BOOT_TIMING
+#define boot_require(drv)       do { if (!(drv).ready) boot_timed_init(&(drv)); } while (0)
+#else
+#define boot_require(drv)       do { if (!(drv).ready) (drv).init(); } while (0)
+#endif /* BOOT_TIMING */
+
+void boot_started(boot_drv_t *drv);
+boot_drv_t *boot_drivers(void);
+
+/*   Built with -dBOOT_TIMING, _CMain()'s own steps and every driver's
+ *   init are recorded as they happen, for boot_dump() to list.
+ */
+#define BOOT_MAX_PHASES     16
+
+/* boot_phase() flags */
+#define BOOT_NOMINAL        0x01    /* Not measured. How long it always takes */
+#define BOOT_UNTIMED        0x02    /* Started inside another's init, or once TIMER was taken */
+#define BOOT_OVERRUN        0x04    /* Took at least CLOCK_STOPWATCH_US */
+
+#ifdef BOOT_TIMING
+void boot_timed_init(boot_drv_t *drv);
+void boot_phase(const char *name, uint32_t us, uint8_t flags);
+void boot_dump(void);
+#endif /* BOOT_TIMING */
+
+#endif /* __BOOT_H__ */
@@ -0,0 +1,189 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   CPU clock detection
+ *
+ *   There's no way of reading back the clock jumper setting, so
+ *   instead a fixed delay loop is run for 20ms worth of TIMER ticks
+ *   and the number of iterations counted. The result is snapped to
+ *   the nearest clock the board can actually run at.
+ *
+ *   The same is then done with a much shorter loop. Between the two,
+ *   that gives both the time each delay_ncycles() count takes, and the
+ *   fixed overhead around it, on whatever board this is. Wait states
+ *   and all. delay_us() and delay_ms() work from those.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include "eod_io.h"
+#include "eod_map.h"
+#include "clock.h"
+#include "util.h"
+#include "dsp.h"
+
+/* 20ms of TIMER ticks */
+#define CAL_TICKS           (uint16_t)(TIMER_HZ / 50)
+#define CAL_NS              (CLOCK_STOPWATCH_US * 1000)
+
+/* 100us per iteration at 10MHz (see util.h), so 200 iterations in 20ms */
+#define CAL_NCYCLES         54
+#define CAL_ITER_10MHZ      200
+
+/* Second, shorter loop for working out the overhead */
+#define CAL_NCYCLES_SHORT   8
+
+/* Until clock_init() is run, assume the fastest */
+uint8_t _g_cpuMhz = 10;
+
+/* delay_ncycles() counts per us, with 8 fractional bits, and the time
+ * taken by the call around it. 10MHz figures from util.h until
+ * clock_init() has measured them.
+ */
+static uint16_t _g_countsPerUs8 = 142;
+static uint16_t _g_overheadUs = 6;
+static uint16_t _g_countsPerMs = 554;
+
+/* Time round the short calibration loop, for the stopwatch */
+static uint32_t _g_spinNs = 20360;
+
+/* Returns how many times delay_ncycles(ncycles) ran in CAL_TICKS */
+static uint16_t clock_count(uint16_t ncycles)
+{
+    uint16_t count = 0;
+
+    /* Interrupts aren't running yet, so just poll the flag */
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(TIMER, (uint16_t)(0x10000UL - CAL_TICKS));
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
+
+    while (!(cpld_read(STATUS) & STATUS_TMF))
+    {
+        delay_ncycles(ncycles);
+        count++;
+    }
+
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+
+    return count;
+}
+
+void clock_init(void)
+{
+    uint16_t count;
+    uint16_t count_short;
+    uint32_t ns;
+    uint32_t ns_short;
+    uint32_t ns_per_count;
+    uint16_t mhz10; /* In tenths of MHz */
+
+    count = clock_count(CAL_NCYCLES);
+    count_short = clock_count(CAL_NCYCLES_SHORT);
+
+    if (!count || count_short <= count)
+        return;
+
+    /* Each iteration is overhead + ncycles * ns_per_count */
+    ns = CAL_NS / count;
+    ns_short = CAL_NS / count_short;
+    _g_spinNs = ns_short;
+    ns_per_count = (ns - ns_short) / (CAL_NCYCLES - CAL_NCYCLES_SHORT);
+
+    if (ns_per_count)
+    {
+        uint32_t overhead = ns_short - (CAL_NCYCLES_SHORT * ns_per_count);
+
+        _g_countsPerUs8 = (uint16_t)((256000UL + (ns_per_count >> 1)) / ns_per_count);
+        _g_overheadUs = (uint16_t)(overhead / 1000);
+        _g_countsPerMs = (uint16_t)((1000000UL - overhead) / ns_per_count);
+    }
+
+    mhz10 = (uint16_t)(((uint32_t)count * 100) / CAL_ITER_10MHZ);
+
+    if (mhz10 < 65)
+        _g_cpuMhz = 5;
+    else if (mhz10 < 90)
+        _g_cpuMhz = 8;
+    else
+        _g_cpuMhz = 10;
+}
+
+/*   Stopwatch, for timing code that runs before interrupts are up,
+ *   e.g. boot. TIMER can't be read back, so it's started with a fixed
+ *   period, and clock_stopwatch_us() spins on the same loop as the
+ *   calibration until it runs out. Whatever's left is the time that
+ *   hadn't passed. Good to a loop (about 20us at 10MHz), and always
+ *   costs CLOCK_STOPWATCH_US whatever's being timed.
+ *
+ *   Not for use once anything else owns TIMER.
+ */
+void clock_stopwatch_start(void)
+{
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(TIMER, (uint16_t)(0x10000UL - CAL_TICKS));
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
+}
+
+/* CLOCK_STOPWATCH_US if it ran out before this was called */
+uint32_t clock_stopwatch_us(void)
+{
+    uint32_t left_us;
+    uint16_t count = 0;
+
+    while (!(cpld_read(STATUS) & STATUS_TMF))
+    {
+        delay_ncycles(CAL_NCYCLES_SHORT);
+        count++;
+    }
+
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+
+    left_us = ((uint32_t)count * _g_spinNs) / 1000;
+
+    if (left_us > CLOCK_STOPWATCH_US)
+        return 0;
+
+    return CLOCK_STOPWATCH_US - left_us;
+}
+
+/*   Never shorter than asked, but can be a few us longer. The overhead
+ *   taken off is rounded down from the calibration loop's, and this
+ *   call, with its MUL, takes longer than that loop's overhead does. So
+ *   anything up to _g_overheadUs is already covered by calling in, and
+ *   the count is rounded up for the rest.
+ */
+void delay_us(uint16_t us)
+{
+    uint16_t count;
+
+    if (us <= _g_overheadUs)
+        return;
+
+    count = (uint16_t)((dsp_mul16(us - _g_overheadUs, _g_countsPerUs8) + 255) >> 8);
+
+    if (count)
+        delay_ncycles(count);
+}
+
+void delay_ms(uint16_t ms)
+{
+    while (ms--)
+        delay_ncycles(_g_countsPerMs);
+}
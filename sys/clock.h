@@ -2,32 +2,46 @@
  *   8OD - Arduino form factor i8086 based SBC
  *   Matthew Millman (tech.mattmillman.com)
  *
- *   HD44780 40x4 LCD driver
+ *   CPU clock detection
  *
  *   This is free software: you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
  *   the Free Software Foundation, either version 2 of the License, or
  *   (at your option) any later version.
-
+ *
  *   This software is distributed in the hope that it will be useful,
  *   but WITHOUT ANY WARRANTY; without even the implied warranty of
  *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
  *   GNU General Public License for more details.
-
+ *
  *   You should have received a copy of the GNU General Public License
  *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
  */
 
-#ifndef __LCD_H__
-#define __LCD_H__
+#ifndef __CLOCK_H__
+#define __CLOCK_H__
+
+#include <stdint.h>
+
+/* 8OD can be jumpered for 5, 8 or 10MHz. MIDCLK (which also clocks
+ * the PCF8584) is always 1.5x the CPU clock.
+ */
+extern uint8_t _g_cpuMhz;
+
+#define clock_cpu_hz()      ((uint32_t)_g_cpuMhz * 1000000UL)
+#define clock_mid_hz()      ((uint32_t)_g_cpuMhz * 1500000UL)
+
+/* clock_init() times two of these, one after the other */
+#define CLOCK_STOPWATCH_US  20000UL
+#define CLOCK_INIT_US       (CLOCK_STOPWATCH_US * 2)
+
+void clock_init(void);
+
+void clock_stopwatch_start(void);
+uint32_t clock_stopwatch_us(void);
 
-void lcd_init(void);
-void lcd_string(const char *data);
-void lcd_home(uint8_t disp);
-void lcd_clear(uint8_t disp);
-void lcd_pos(uint8_t row, uint8_t col);
-void lcd_cgpopulate(uint8_t idx, const char *data);
-void lcd_backspace(void);
-void lcd_return(void);
+/* Calibrated against TIMER by clock_init() */
+void delay_us(uint16_t us);
+void delay_ms(uint16_t ms);
 
-#endif /* __LCD_H__ */
+#endif /* __CLOCK_H__ */
@@ -4,6 +4,15 @@
  *
  *   C based initialisation for "boot from flash" applications
  *
+ *   Only what every app needs is done here. The MID, I2C, SPI flash and
+ *   ADC drivers start themselves on first use (see boot.h), so an app
+ *   that never touches one doesn't wait for it.
+ *
+ *   Built with -dBOOT_TIMING, each step here, and each driver's init as
+ *   boot_require() starts it, is timed and can be listed with
+ *   boot_dump() (boot.c) from main(). Each timed step then takes an
+ *   extra 20ms, see clock_stopwatch_us().
+ *
  *   This is free software: you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
  *   the Free Software Foundation, either version 2 of the License, or
@@ -19,15 +28,12 @@
  */
 
 #include <stdint.h>
-#include <stdio.h>
 #include <stdlib.h>
 #include <i86.h>
 
 #include "eod_io.h"
-#include "mid.h"
-#include "i2c.h"
-#include "spiflash.h"
-#include "adc.h"
+#include "clock.h"
+#include "boot.h"
 
 #pragma aux     _CMain  "_*";
 
@@ -36,6 +42,9 @@
  * 0x0000 - 0x1FFF 8K  : _DATA (DGROUP)
  * 0x1FFF - 0x7FFF 24K : STACK
  * 0x8000 - 0xFFFF 32K : HEAP
+ *
+ * Everything from 0x30000 up to the bootrom at 0x70000 is left to
+ * farheap.c, which starts the first time something asks it for a block.
  */
 
 extern void main(void);
@@ -48,27 +57,28 @@ extern void __InitFiles(void);
 extern uint16_t far _heap_start;
 extern uint16_t far _heap_size;
 
+#ifdef BOOT_TIMING
+#define boot_timed(name, step) \
+    do { clock_stopwatch_start(); step; boot_phase(name, clock_stopwatch_us(), 0); } while (0)
+#else
+#define boot_timed(name, step) step
+#endif /* BOOT_TIMING */
+
 void _CMain(void)
 {
     //_amblksiz = 8 * 1024;   /* set minimum memory block allocation */
     io_init();
-#ifndef NO_MID
-    mid_init(M_CLK_DIV4);
-#endif /* NO_MID */
-#ifndef NO_I2C
-    i2c_init(ICLK4, OCLK0);
-#endif /* NO_I2C */
-#ifndef NO_SPIFLASH
-    spiflash_init();
-#endif /* NO_SPIFLASH */
-#ifndef NO_ADC
-    adc_init();
-#endif /* NO_ADC */
+
+    /* Needs TIMER itself, so can't be timed, but always takes as long */
+    clock_init();
+#ifdef BOOT_TIMING
+    boot_phase("clock", CLOCK_INIT_US, BOOT_NOMINAL);
+#endif /* BOOT_TIMING */
 
     /* Setup malloc() */
-    __HeapInit((void _WCNEAR *)_heap_start, _heap_size);
+    boot_timed("heap", __HeapInit((void _WCNEAR *)_heap_start, _heap_size));
     /* Init stdin, stdout, stderr */
-    __InitFiles();
+    boot_timed("files", __InitFiles());
 
     for (;;)
     {
@@ -17,6 +17,17 @@
 ;   You should have received a copy of the GNU General Public License
 ;   along with this software.  If not, see <http://www.gnu.org/licenses/>.
 ;
+;   Memory map:
+;
+;   0x00000 - 0x003FF	Interrupt vectors
+;   0x10000 - 0x1FFFF	START and _TEXT
+;   0x20000 - 0x2FFFF	DGROUP. _DATA and _BSS, the stack down from
+;						STACKTOP, then the near heap for malloc()
+;   0x30000 - 0x6FFFF	Far heap (farheap.c), for buffers too big for
+;						DGROUP. Caches, capture rings, flash staging
+;   0x70000 - 0x7FFFF	Used by the bootrom
+;   0x80000 - 0xFFFFF	Flash
+;
 
 STACKTOP		equ	8000h		;	0x27FFF
 
@@ -43,6 +54,12 @@ STACK	ends
 _DATA	segment word public 'DATA'
 __curbrk		dw	0FFFFh
 	public	__curbrk
+
+; CS:IP that the last NMI interrupted
+__g_irqIp		dw	0
+__g_irqCs		dw	0
+	public	__g_irqIp
+	public	__g_irqCs
 _DATA	ends
 
 _BSS	segment word public 'BSS'
@@ -122,11 +139,32 @@ nm_interrupt proc near
 		; The rest will be saved to the stack by interrupt_handler().
 		; 
 		; *** CAVEAT EMPTOR ***
-		; This interrupt mechanism does not save SS, DS or ES, because
-		; it's using the 'small' model, and these *shouldn't* be modified
-		; in interrupt_handler(), unless some insolent code specifically
-		; does, likely by using 'far' pointers. In this case these registers
-		; need to be saved to the stack too.
+		; This interrupt mechanism does not save SS, because it's using
+		; the 'small' model, and it *shouldn't* be modified anywhere.
+		; ES is saved, as handlers which write to far RAM (adccap, prof)
+		; load it behind the compiler's back. DS is saved and put back
+		; to DGROUP from SS, as memcpy_far() borrows it for the source.
+		push	ax
+		push	es
+		push	ds
+		mov		ax,		ss
+		mov		ds,		ax
+
+		; Note where we were, for prof.c. IP and CS are above BP, DS,
+		; ES and AX.
+		push	bp
+		mov		bp,		sp
+		mov		ax,		[bp + 8]
+		mov		word ptr __g_irqIp,	ax
+		mov		ax,		[bp + 10]
+		mov		word ptr __g_irqCs,	ax
+		pop		bp
+
+		; Remember whether GINT was set. It won't have been if we've
+		; landed in the middle of cpld_int_disable(), in which case it
+		; has to stay off when we leave.
+		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
+		and		ax,		CONFIG_GINT
 		push	ax
 
 		; Disable interrupts globally
@@ -141,10 +179,13 @@ nm_interrupt proc near
 		; Re-enable interrupts globally
 		; Makes sure that anything which happened while we were
 		; in interrupt_handler() re-triggers NMI interrupt
-		or		word ptr __g_shadowRegisters + CONFIG_REG,	CONFIG_GINT
+		pop		ax
+		or		word ptr __g_shadowRegisters + CONFIG_REG,	ax
 		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
 		out		CONFIG_REG,	ax
 
+		pop		ds
+		pop		es
 		pop		ax
 
 		iret
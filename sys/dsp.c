@@ -0,0 +1,190 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Fixed point filtering for ADC data
+ *
+ *   An 8086 takes well over 100 clocks for a MUL, and a 32-bit multiply
+ *   or divide through the C library costs several times that. So all
+ *   of the per-sample work here is adds, shifts, and at most one 16-bit
+ *   MUL per tap. Divisions only happen once, in dsp_scale_init().
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include "dsp.h"
+
+/*   Takes 4^bits samples and decimates them to a result with bits extra
+ *   bits of resolution, e.g. bits = 2 turns 16 12-bit samples into one
+ *   14-bit sample. Only works if there's at least 1 LSB of noise on the
+ *   input, which there always is on the AD7490. bits is limited to 4.
+ */
+uint16_t dsp_oversample(dsp_source_t source, int arg, uint8_t bits)
+{
+    uint32_t sum = 0;
+    uint16_t n;
+    uint16_t i;
+
+    if (bits > 4)
+        bits = 4;
+
+    n = 1 << (bits << 1);
+
+    for (i = 0; i < n; i++)
+        sum += source(arg);
+
+    return (uint16_t)(sum >> bits);
+}
+
+/* Works out the most precise multiplier for num / den */
+void dsp_scale_init(dsp_scale_t *s, uint32_t num, uint32_t den)
+{
+    uint8_t shift;
+
+    for (shift = 16; shift > 0; shift--)
+    {
+        uint32_t mul;
+
+        /* num << shift mustn't overflow */
+        if (num >> (32 - shift))
+            continue;
+
+        mul = ((num << shift) + (den >> 1)) / den;
+
+        if (mul <= 0xFFFF)
+            break;
+    }
+
+    s->mul = (uint16_t)(((num << shift) + (den >> 1)) / den);
+    s->shift = shift;
+}
+
+uint16_t dsp_scale(const dsp_scale_t *s, uint16_t x)
+{
+    uint32_t product = dsp_mul16(x, s->mul);
+
+    /* Most of the time this is just the high word */
+    if (s->shift == 16)
+        return (uint16_t)(product >> 16);
+
+    return (uint16_t)(product >> s->shift);
+}
+
+/* buf must hold 2^len_log2 samples. len_log2 is limited to 4 */
+void dsp_ma_init(dsp_ma_t *ma, uint16_t *buf, uint8_t len_log2)
+{
+    if (len_log2 > 4)
+        len_log2 = 4;
+
+    ma->buf = buf;
+    ma->sum = 0;
+    ma->mask = (1 << len_log2) - 1;
+    ma->pos = 0;
+    ma->shift = len_log2;
+    ma->primed = 0;
+}
+
+uint16_t dsp_ma_update(dsp_ma_t *ma, uint16_t x)
+{
+    if (!ma->primed)
+    {
+        uint8_t i;
+
+        /* Start from the first sample rather than ramping up from 0 */
+        for (i = 0; i <= ma->mask; i++)
+            ma->buf[i] = x;
+
+        ma->sum = x << ma->shift;
+        ma->primed = 1;
+
+        return x;
+    }
+
+    ma->sum -= ma->buf[ma->pos];
+    ma->sum += x;
+    ma->buf[ma->pos] = x;
+    ma->pos = (ma->pos + 1) & ma->mask;
+
+    return ma->sum >> ma->shift;
+}
+
+/* y += (x - y) / 2^k. Settles to within 1% in about 4.6 * 2^k samples */
+void dsp_iir_init(dsp_iir_t *iir, uint8_t k)
+{
+    iir->state = 0;
+    iir->k = k;
+    iir->primed = 0;
+}
+
+uint16_t dsp_iir_update(dsp_iir_t *iir, uint16_t x)
+{
+    if (!iir->primed)
+    {
+        iir->state = x << 3;
+        iir->primed = 1;
+    }
+    else
+    {
+        /* Both sides fit in 15 bits, so the difference fits an int16_t */
+        iir->state += (int16_t)((x << 3) - iir->state) >> iir->k;
+    }
+
+    return (iir->state + 4) >> 3;
+}
+
+void dsp_fir_init(dsp_fir_t *fir, const int16_t *coeffs, uint8_t taps)
+{
+    uint8_t i;
+
+    if (taps > DSP_MAX_TAPS)
+        taps = DSP_MAX_TAPS;
+
+    fir->coeffs = coeffs;
+    fir->taps = taps;
+    fir->pos = 0;
+
+    for (i = 0; i < DSP_MAX_TAPS; i++)
+        fir->hist[i] = 0;
+}
+
+uint16_t dsp_fir_update(dsp_fir_t *fir, uint16_t x)
+{
+    int32_t acc = 0;
+    uint8_t pos;
+    uint8_t i;
+
+    fir->hist[fir->pos] = (int16_t)x;
+    pos = fir->pos;
+
+    /* coeffs[0] applies to the newest sample */
+    for (i = 0; i < fir->taps; i++)
+    {
+        acc += dsp_imul16(fir->coeffs[i], fir->hist[pos]);
+        pos = pos ? pos - 1 : fir->taps - 1;
+    }
+
+    fir->pos = (fir->pos + 1 < fir->taps) ? fir->pos + 1 : 0;
+
+    acc = (acc + 0x4000) >> 15;
+
+    if (acc < 0)
+        return 0;
+
+    if (acc > 0x7FFF)
+        return 0x7FFF;
+
+    return (uint16_t)acc;
+}
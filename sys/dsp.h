@@ -0,0 +1,101 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Fixed point filtering for ADC data
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __DSP_H__
+#define __DSP_H__
+
+#include <stdint.h>
+
+/* Everything here expects samples of 12 bits or less (i.e. the AD7490) */
+
+/* Single 16x16->32 MUL / IMUL. Watcom otherwise calls out to __U4M / __I4M
+ * for any 32-bit product, even when both operands are only 16 bits.
+ */
+uint32_t dsp_mul16(uint16_t a, uint16_t b);
+
+#pragma aux dsp_mul16 = \
+    "mul dx" \
+    parm [ax] [dx] \
+    value [dx ax] \
+    modify exact [ax dx];
+
+int32_t dsp_imul16(int16_t a, int16_t b);
+
+#pragma aux dsp_imul16 = \
+    "imul dx" \
+    parm [ax] [dx] \
+    value [dx ax] \
+    modify exact [ax dx];
+
+#define DSP_MAX_TAPS        16
+
+typedef uint16_t (*dsp_source_t)(int arg);
+
+/* x * num / den, as a multiply and shift */
+typedef struct
+{
+    uint16_t mul;
+    uint8_t shift;
+} dsp_scale_t;
+
+/* Static initialiser for a dsp_scale_t, for when num / den < 1 */
+#define DSP_SCALE_INIT(num, den) \
+    { (uint16_t)((((uint32_t)(num) << 16) + ((den) >> 1)) / (den)), 16 }
+
+typedef struct
+{
+    uint16_t *buf;
+    uint16_t sum;
+    uint8_t mask;
+    uint8_t pos;
+    uint8_t shift;
+    uint8_t primed;
+} dsp_ma_t;
+
+typedef struct
+{
+    uint16_t state;             /* Output with 3 fractional bits */
+    uint8_t k;                  /* Time constant. Alpha = 1 / 2^k */
+    uint8_t primed;
+} dsp_iir_t;
+
+typedef struct
+{
+    const int16_t *coeffs;      /* Q15, sum to <= 1.0 */
+    int16_t hist[DSP_MAX_TAPS];
+    uint8_t taps;
+    uint8_t pos;
+} dsp_fir_t;
+
+uint16_t dsp_oversample(dsp_source_t source, int arg, uint8_t bits);
+
+void dsp_scale_init(dsp_scale_t *s, uint32_t num, uint32_t den);
+uint16_t dsp_scale(const dsp_scale_t *s, uint16_t x);
+
+void dsp_ma_init(dsp_ma_t *ma, uint16_t *buf, uint8_t len_log2);
+uint16_t dsp_ma_update(dsp_ma_t *ma, uint16_t x);
+
+void dsp_iir_init(dsp_iir_t *iir, uint8_t k);
+uint16_t dsp_iir_update(dsp_iir_t *iir, uint16_t x);
+
+void dsp_fir_init(dsp_fir_t *fir, const int16_t *coeffs, uint8_t taps);
+uint16_t dsp_fir_update(dsp_fir_t *fir, uint16_t x);
+
+#endif /* __DSP_H__ */
@@ -25,6 +25,32 @@
 
 uint16_t _g_shadowRegisters[NUM_CPLD_SHADOWS];
 
+/* Only masks interrupts for registers in CPLD_SHARED_REGS */
+void cpld_write_atomic(uint8_t reg, uint16_t mask, uint16_t value)
+{
+    uint16_t gint;
+
+    if (!(CPLD_SHARED_REGS & cpld_reg_bit(reg)))
+    {
+        cpld_write(reg, mask, value);
+        return;
+    }
+
+    gint = cpld_int_disable();
+
+    /* Changing GINT itself. It mustn't go on until the end. */
+    if (reg == CONFIG && (mask & CONFIG_GINT))
+    {
+        gint = value & CONFIG_GINT;
+        mask &= ~CONFIG_GINT;
+        value &= ~CONFIG_GINT;
+    }
+
+    cpld_write(reg, mask, value);
+
+    cpld_int_restore(gint);
+}
+
 void io_init(void)
 {
     /* Set shadows to their physical reset values */
@@ -32,7 +32,30 @@ extern unsigned _inline_outpw(unsigned __port, unsigned __value);
 #define outp(reg, value) _inline_outp(reg, value)
 #define outpw(reg, value) _inline_outpw(reg, value)
 
-/* For write-only registers, keeps a shadow of current value for partial modifications */
+/*   For write-only registers, keeps a shadow of current value for partial modifications
+ *
+ *   cpld_write() isn't atomic. If an interrupt handler writes the same
+ *   register part way through, one or other change is lost. So each
+ *   register has an owner:
+ *
+ *   Registers in CPLD_SHARED_REGS are written from interrupt handlers
+ *   as well as the main loop. The main loop must use cpld_write_atomic()
+ *   for them, which turns GINT off around the write. Handlers can carry
+ *   on using cpld_write(), as GINT is already off.
+ *
+ *   Everything else only ever gets written from one place, and so can
+ *   use cpld_write(), with no masking, e.g. the W5100's chip select on
+ *   PORTA.
+ *
+ *   Apps with handlers that write other registers add them with
+ *   -dCPLD_SHARED_REGS=...
+ */
+#ifndef CPLD_SHARED_REGS
+#define CPLD_SHARED_REGS    cpld_reg_bit(CONFIG)
+#endif /* CPLD_SHARED_REGS */
+
+#define cpld_reg_bit(reg)   (1 << ((reg) >> 1))
+
 extern uint16_t _g_shadowRegisters[NUM_CPLD_SHADOWS];
 #define cpld_write(reg, mask, value)                                                        \
     do {                                                                                    \
@@ -50,4 +73,10 @@ extern uint16_t _g_shadowRegisters[NUM_CPLD_SHADOWS];
 #define cpld_shadow_read(reg) \
     *((uint16_t *)((uint8_t *)_g_shadowRegisters + reg))
 
+void cpld_write_atomic(uint8_t reg, uint16_t mask, uint16_t value);
+
+/* In util.asm */
+uint16_t cpld_int_disable(void);
+void cpld_int_restore(uint16_t gint);
+
 void io_init(void);
@@ -80,6 +80,12 @@
 #endif /* !LBUS_CPLD */
 #define TIMER               0x18    /* Timer register. Sets start count for timer */
 
+/* TIMER counts up from the start count, flagging STATUS_TMF on overflow.
+ * It runs at a fixed rate regardless of the CPU clock selected.
+ * 0xC000 (16384 ticks) is approximately 100ms.
+ */
+#define TIMER_HZ            163840UL
+
 #define UARTA_BASE          0x20    /* UART A IO Addr. Only supports 8 bit accesses */
 #define UARTB_BASE          0x28    /* UART B IO Addr. Only supports 8 bit accesses */
 #define UARTC_BASE          0x30    /* UART C IO Addr. Only supports 8 bit accesses */
@@ -94,3 +100,9 @@
 
 /* Shadow registers */
 #define NUM_CPLD_SHADOWS    16      /* Number of 16 bit shorts to store CPLD shadow registers */
+
+/* Far RAM (0x30000 - 0x6FFFF). Unused by "boot from flash" applications,
+ * which live entirely within 0x10000 - 0x2FFFF. Handed out by farheap.c.
+ */
+#define FAR_RAM_SEG         0x3000
+#define FAR_RAM_SIZE        0x40000
@@ -0,0 +1,274 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Far RAM allocator
+ *
+ *   The 256K at 0x30000 - 0x6FFFF is outside DGROUP, so malloc() can't
+ *   see it. Buffers that don't need to be in DGROUP (caches, capture
+ *   rings, flash staging) come from here instead, as a segment of their
+ *   own that starts at offset 0.
+ *
+ *   Blocks are whole paragraphs, one after the other, each with a
+ *   paragraph of header in front saying how long it is and whether it's
+ *   in use. Allocation is first fit, merging runs of free blocks as it
+ *   goes past them. Frees merge with whatever free block follows. Both
+ *   are a walk along the blocks, but there's only ever a handful, and
+ *   they're meant to be taken once at startup or around something slow
+ *   like a flash erase, not per packet (see pool.c for that).
+ *
+ *   Main loop only. Nothing here masks interrupts.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <i86.h>
+#include "eod_map.h"
+#include "boot.h"
+#include "farheap.h"
+
+#define FARHEAP_START       FAR_RAM_SEG
+#define FARHEAP_END         (FAR_RAM_SEG + (uint16_t)(FAR_RAM_SIZE / FARHEAP_PARA))
+
+#define FARHEAP_TAG_USED    0xFA12
+#define FARHEAP_TAG_FREE    0xF4EE
+
+/* Takes up the whole of the paragraph in front of each block */
+typedef struct
+{
+    uint16_t tag;
+    uint16_t paras;             /* Including this header */
+} farheap_hdr_t;
+
+#define farheap_hdr(seg)    ((farheap_hdr_t far *)MK_FP(seg, 0))
+
+boot_drv_t _g_farheapDrv = BOOT_DRV("farheap", farheap_init);
+
+static uint16_t _g_farheapUsed;
+static uint16_t _g_farheapHigh;
+static uint16_t _g_farheapFailures;
+static uint16_t _g_farheapCorrupt;
+
+/* Called on first use. Everything starts out as one free block. */
+void farheap_init(void)
+{
+    farheap_hdr_t far *h = farheap_hdr(FARHEAP_START);
+
+    if (_g_farheapDrv.ready)
+        return;
+
+    h->tag = FARHEAP_TAG_FREE;
+    h->paras = FARHEAP_END - FARHEAP_START;
+
+    _g_farheapUsed = 0;
+    _g_farheapHigh = 0;
+    _g_farheapFailures = 0;
+    _g_farheapCorrupt = 0;
+
+    boot_started(&_g_farheapDrv);
+}
+
+/* Something has written over a header if this fails, and the walk can't go on */
+static int farheap_valid(uint16_t seg)
+{
+    farheap_hdr_t far *h = farheap_hdr(seg);
+
+    return (h->tag == FARHEAP_TAG_USED || h->tag == FARHEAP_TAG_FREE) &&
+        h->paras && h->paras <= FARHEAP_END - seg;
+}
+
+/* Soaks up any free blocks directly after the free one at seg */
+static void farheap_merge(uint16_t seg)
+{
+    farheap_hdr_t far *h = farheap_hdr(seg);
+    uint16_t next;
+
+    while ((next = seg + h->paras) < FARHEAP_END &&
+        farheap_valid(next) && farheap_hdr(next)->tag == FARHEAP_TAG_FREE)
+    {
+        h->paras += farheap_hdr(next)->paras;
+    }
+}
+
+/* Segment of at least size bytes, at offset 0. 0 if there isn't room. */
+uint16_t farheap_alloc_seg(uint32_t size)
+{
+    uint16_t paras;
+    uint16_t seg;
+
+    boot_require(_g_farheapDrv);
+
+    if (!size || size > FAR_RAM_SIZE - FARHEAP_PARA)
+    {
+        _g_farheapFailures++;
+        return 0;
+    }
+
+    paras = (uint16_t)((size + FARHEAP_PARA - 1) / FARHEAP_PARA) + 1;
+
+    for (seg = FARHEAP_START; seg < FARHEAP_END; seg += farheap_hdr(seg)->paras)
+    {
+        farheap_hdr_t far *h = farheap_hdr(seg);
+
+        if (!farheap_valid(seg))
+        {
+            _g_farheapCorrupt++;
+            break;
+        }
+
+        if (h->tag != FARHEAP_TAG_FREE)
+            continue;
+
+        farheap_merge(seg);
+
+        if (h->paras < paras)
+            continue;
+
+        /* Split off whatever's left over as a free block */
+        if (h->paras > paras)
+        {
+            farheap_hdr_t far *rest = farheap_hdr(seg + paras);
+
+            rest->tag = FARHEAP_TAG_FREE;
+            rest->paras = h->paras - paras;
+            h->paras = paras;
+        }
+
+        h->tag = FARHEAP_TAG_USED;
+
+        _g_farheapUsed += paras;
+
+        if (_g_farheapUsed > _g_farheapHigh)
+            _g_farheapHigh = _g_farheapUsed;
+
+        return seg + 1;
+    }
+
+    _g_farheapFailures++;
+
+    return 0;
+}
+
+/* seg as returned by farheap_alloc_seg(). 0 is ignored. */
+void farheap_free_seg(uint16_t seg)
+{
+    farheap_hdr_t far *h;
+
+    if (!seg)
+        return;
+
+    if (!_g_farheapDrv.ready || seg <= FARHEAP_START || seg >= FARHEAP_END)
+    {
+        _g_farheapCorrupt++;
+        return;
+    }
+
+    h = farheap_hdr(seg - 1);
+
+    if (h->tag != FARHEAP_TAG_USED || !farheap_valid(seg - 1))
+    {
+        _g_farheapCorrupt++;
+        return;
+    }
+
+    h->tag = FARHEAP_TAG_FREE;
+    _g_farheapUsed -= h->paras;
+
+    farheap_merge(seg - 1);
+}
+
+/* NULL if there isn't room */
+void far *farheap_alloc(uint32_t size)
+{
+    uint16_t seg = farheap_alloc_seg(size);
+
+    if (!seg)
+        return NULL;
+
+    return MK_FP(seg, 0);
+}
+
+/* p must be exactly as farheap_alloc() returned it */
+void farheap_free(void far *p)
+{
+    if (!p)
+        return;
+
+    if (FP_OFF(p))
+    {
+        _g_farheapCorrupt++;
+        return;
+    }
+
+    farheap_free_seg(FP_SEG(p));
+}
+
+void farheap_get_stats(farheap_stats_t *stats)
+{
+    uint16_t seg;
+
+    boot_require(_g_farheapDrv);
+
+    stats->used = _g_farheapUsed;
+    stats->free = 0;
+    stats->high_water = _g_farheapHigh;
+    stats->largest = 0;
+    stats->blocks = 0;
+    stats->failures = _g_farheapFailures;
+    stats->corrupt = _g_farheapCorrupt;
+
+    for (seg = FARHEAP_START; seg < FARHEAP_END && farheap_valid(seg); seg += farheap_hdr(seg)->paras)
+    {
+        farheap_hdr_t far *h = farheap_hdr(seg);
+
+        if (h->tag == FARHEAP_TAG_USED)
+        {
+            stats->blocks++;
+            continue;
+        }
+
+        farheap_merge(seg);
+
+        stats->free += h->paras;
+
+        if (h->paras - 1 > stats->largest)
+            stats->largest = h->paras - 1;
+    }
+}
+
+/* Every block in address order, to stdout */
+void farheap_dump(void)
+{
+    farheap_stats_t stats;
+    uint16_t seg;
+
+    farheap_get_stats(&stats);
+
+    printf("%-6s %8s %s\r\n", "Seg", "Bytes", "State");
+
+    for (seg = FARHEAP_START; seg < FARHEAP_END && farheap_valid(seg); seg += farheap_hdr(seg)->paras)
+    {
+        farheap_hdr_t far *h = farheap_hdr(seg);
+
+        printf("%04X   %8lu %s\r\n", seg + 1, (uint32_t)(h->paras - 1) * FARHEAP_PARA,
+            h->tag == FARHEAP_TAG_USED ? "used" : "free");
+    }
+
+    printf("Used %lu High %lu Largest free %lu Fail %u Bad %u\r\n",
+        (uint32_t)stats.used * FARHEAP_PARA, (uint32_t)stats.high_water * FARHEAP_PARA,
+        (uint32_t)stats.largest * FARHEAP_PARA, stats.failures, stats.corrupt);
+}
@@ -0,0 +1,54 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Far RAM allocator
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __FARHEAP_H__
+#define __FARHEAP_H__
+
+#include <stdint.h>
+#include "boot.h"
+
+/* Every block starts on a paragraph, at offset 0 of its own segment */
+#define FARHEAP_PARA        16
+
+typedef struct
+{
+    uint16_t used;              /* Paragraphs, including each block's header */
+    uint16_t free;
+    uint16_t high_water;
+    uint16_t largest;           /* Biggest single block that could be had now */
+    uint16_t blocks;
+    uint16_t failures;          /* Allocations turned away */
+    uint16_t corrupt;           /* Frees of something that wasn't an allocated block */
+} farheap_stats_t;
+
+extern boot_drv_t _g_farheapDrv;
+
+void farheap_init(void);
+
+uint16_t farheap_alloc_seg(uint32_t size);
+void farheap_free_seg(uint16_t seg);
+
+void far *farheap_alloc(uint32_t size);
+void farheap_free(void far *p);
+
+void farheap_get_stats(farheap_stats_t *stats);
+void farheap_dump(void);
+
+#endif /* __FARHEAP_H__ */
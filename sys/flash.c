@@ -0,0 +1,205 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Flash driver
+ *
+ *   Helpers common to both flash_ops_t implementations.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <i86.h>
+#include "eod_map.h"
+#include "util.h"
+#include "farheap.h"
+#include "flash.h"
+
+#define flash_stage_ptr(seg, pos) \
+    ((uint8_t far *)MK_FP((seg) + (uint16_t)((pos) >> 4), 0))
+
+/* Find the erase block containing offset */
+static int flash_sector_of(const flash_ops_t *ops, uint32_t offset, uint32_t *start, uint32_t *len)
+{
+    uint16_t block_data_len;
+    flash_erase_block_t *block_data;
+    uint32_t erase_size;
+    uint32_t boot_offset;
+    uint32_t size;
+    uint16_t i;
+
+    size = ops->get_geometry(&block_data_len, &block_data, &erase_size, &boot_offset);
+
+    if (offset >= size)
+        return 0;
+
+    if (!block_data_len)
+    {
+        /* Uniform sectors */
+        *start = offset & ~(erase_size - 1);
+        *len = erase_size;
+        return 1;
+    }
+
+    for (i = 0; i < block_data_len; i++)
+    {
+        if (offset >= block_data[i].start && offset < block_data[i].start + block_data[i].length)
+        {
+            *start = block_data[i].start;
+            *len = block_data[i].length;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+/* Merge whatever part of the update lands in the page at page_start */
+static void flash_merge_page(uint8_t *page, uint32_t page_start, uint32_t offset, uint16_t len, const uint8_t far *buf)
+{
+    uint32_t from = offset > page_start ? offset : page_start;
+    uint32_t to = (offset + len) < (page_start + FLASH_WRITE_SIZE) ? (offset + len) : (page_start + FLASH_WRITE_SIZE);
+
+    if (from < to)
+        memcpy_far(page + (uint16_t)(from - page_start), buf + (uint16_t)(from - offset), (uint16_t)(to - from));
+}
+
+/*   Rewrite len bytes at offset, preserving everything else around them.
+ *
+ *   If the new data only clears bits, the affected pages are simply
+ *   programmed over the top. Otherwise the whole erase block is copied
+ *   to far RAM, merged, erased, and only the pages which aren't blank
+ *   are programmed back. The far RAM is only taken for as long as that
+ *   takes, and if there isn't enough, nothing is erased and it fails.
+ *   Any block cache over the same flash must be invalidated by the
+ *   caller.
+ */
+int flash_update(const flash_ops_t *ops, uint32_t offset, uint16_t len, const uint8_t far *buf)
+{
+    uint8_t old[FLASH_WRITE_SIZE];
+    uint8_t new[FLASH_WRITE_SIZE];
+    uint32_t end = offset + len;
+    uint32_t pos = offset;
+
+    while (pos < end)
+    {
+        uint32_t sector_start;
+        uint32_t sector_len;
+        uint32_t first_page;
+        uint32_t last_page;
+        uint32_t page;
+        int need_erase = 0;
+        int changed = 0;
+        uint16_t i;
+
+        if (!flash_sector_of(ops, pos, &sector_start, &sector_len))
+            return 0;
+
+        first_page = pos & ~((uint32_t)FLASH_WRITE_SIZE - 1);
+        last_page = ((end < sector_start + sector_len ? end : sector_start + sector_len) - 1) & ~((uint32_t)FLASH_WRITE_SIZE - 1);
+
+        /* Work out what we're going to have to do before touching anything */
+        for (page = first_page; page <= last_page; page += FLASH_WRITE_SIZE)
+        {
+            ops->read(page, FLASH_WRITE_SIZE, old);
+            memcpy(new, old, FLASH_WRITE_SIZE);
+            flash_merge_page(new, page, offset, len, buf);
+
+            for (i = 0; i < FLASH_WRITE_SIZE; i++)
+            {
+                if (old[i] != new[i])
+                    changed = 1;
+
+                if ((old[i] & new[i]) != new[i])
+                    need_erase = 1;
+            }
+
+            if (need_erase)
+                break;
+        }
+
+        if (!changed && !need_erase)
+        {
+            /* Nothing to do */
+        }
+        else if (!need_erase)
+        {
+            /* 1 -> 0 only. Program just the pages that differ. */
+            for (page = first_page; page <= last_page; page += FLASH_WRITE_SIZE)
+            {
+                ops->read(page, FLASH_WRITE_SIZE, old);
+                memcpy(new, old, FLASH_WRITE_SIZE);
+                flash_merge_page(new, page, offset, len, buf);
+
+                if (!memcmp(old, new, FLASH_WRITE_SIZE))
+                    continue;
+
+                if (!ops->write(page, FLASH_WRITE_SIZE, new))
+                    return 0;
+            }
+        }
+        else
+        {
+            /* Stage the whole block, merge, erase, program back */
+            uint16_t stage = farheap_alloc_seg(sector_len);
+
+            if (!stage)
+                return 0;
+
+            for (page = 0; page < sector_len; page += FLASH_WRITE_SIZE)
+            {
+                ops->read(sector_start + page, FLASH_WRITE_SIZE, new);
+                flash_merge_page(new, sector_start + page, offset, len, buf);
+                memcpy_far(flash_stage_ptr(stage, page), new, FLASH_WRITE_SIZE);
+            }
+
+            if (!ops->erase(sector_start, sector_len))
+            {
+                farheap_free_seg(stage);
+                return 0;
+            }
+
+            for (page = 0; page < sector_len; page += FLASH_WRITE_SIZE)
+            {
+                uint8_t blank = 0xFF;
+
+                memcpy_far(new, flash_stage_ptr(stage, page), FLASH_WRITE_SIZE);
+
+                for (i = 0; i < FLASH_WRITE_SIZE; i++)
+                    blank &= new[i];
+
+                /* Already looks like that after the erase */
+                if (blank == 0xFF)
+                    continue;
+
+                if (!ops->write(sector_start + page, FLASH_WRITE_SIZE, new))
+                {
+                    farheap_free_seg(stage);
+                    return 0;
+                }
+            }
+
+            farheap_free_seg(stage);
+        }
+
+        pos = sector_start + sector_len;
+    }
+
+    ops->wait_write();
+
+    return 1;
+}
@@ -45,4 +45,7 @@ typedef struct
 
 #define FLASH_WRITE_SIZE          0x100
 
+/* buf may be near or far, e.g. straight out of a blkdev cache line */
+int flash_update(const flash_ops_t *ops, uint32_t offset, uint16_t len, const uint8_t far *buf);
+
 #endif /* __FLASH_H__ */
@@ -20,40 +20,37 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include <stddef.h>
 
 #include "eod_io.h"
 #include "eod_map.h"
 #include "i2c.h"
+#include "pcf8584.h"
 #include "util.h"
+#include "clock.h"
+#include "boot.h"
 
-#define PCF8584_SX      (I2C_BASE + 0)
-#define PCF8584_S1      (I2C_BASE + 1)
-
-/* S1 Write */
-#define S1_PIN          (1 << 7)
-#define S1_ESO          (1 << 6)
-#define S1_ENI          (1 << 3)
-#define S1_STA          (1 << 2)
-#define S1_STO          (1 << 1)
-#define S1_ACK          (1 << 0)
-#define S1_ESMSK        ((1 << 5) | (1 << 4))
-/* ESO = 0 */
-#define S1_S0SEL        0
-#define S1_S3SEL        (1 << 4)
-#define S1_S2SEL        (1 << 5)
-/* ESO = 1 */
-#define S1_DATASEL      0
-
-/* S1 Read */
-#define S1_STS          (1 << 5)
-#define S1_BER          (1 << 4)
-#define S1_LRB          (1 << 3)
-#define S1_AAS          (1 << 2)
-#define S1_LAB          (1 << 1)
-#define S1_BB           (1 << 0)
+static uint8_t _g_i2cClock;
+
+static void i2c_start(void);
+boot_drv_t _g_i2cDrv = BOOT_DRV("i2c", i2c_start);
+
+/* S2 internal clock settings, and the clock (KHz) each one assumes */
+static const uint8_t _g_iclkSel[] = { ICLK0, ICLK1, ICLK2, ICLK3, ICLK4 };
+static const uint16_t _g_iclkKhz[] = { 3000, 4430, 6000, 8000, 12000 };
+
+/* SCL (Hz) for each of OCLK0 - 3 when the internal clock setting is correct */
+static const uint16_t _g_oclkHz[] = { 45000, 22500, 5625, 750 };
+
+static void i2c_start(void)
+{
+    i2c_set_speed_hz(I2C_DEFAULT_HZ);
+}
 
 void i2c_init(uint8_t iclkdiv, uint8_t oclkdiv)
 {
+    boot_started(&_g_i2cDrv);
+
     /* PCF8584 Intel/Motorola bus selection is done in the
      * bootrom by the master reset handler (cstrt086.asm)
      */
@@ -63,18 +60,78 @@ void i2c_init(uint8_t iclkdiv, uint8_t oclkdiv)
     outp(PCF8584_SX, 0x01);
 
     /* Setup clock. See i2c.h for more detail. */
+    _g_i2cClock = iclkdiv | oclkdiv;
     outp(PCF8584_S1, S1_PIN | S1_S2SEL);
-    outp(PCF8584_SX, iclkdiv | oclkdiv);
+    outp(PCF8584_SX, _g_i2cClock);
 
     /* Enter operational mode */
     outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_ACK);
 }
 
+/* Returns the SCL actually applied */
+uint32_t i2c_set_speed_hz(uint32_t hz)
+{
+    uint32_t midkhz = clock_mid_hz() / 1000;
+    uint32_t best = 0;
+    uint8_t iclk = ICLK4;
+    uint8_t oclk = OCLK3;
+    int i;
+    int o;
+
+    for (i = 0; i < sizeof(_g_iclkSel); i++)
+    {
+        for (o = 0; o < sizeof(_g_oclkHz) / sizeof(uint16_t); o++)
+        {
+            /* Doubled, as 90KHz won't fit in the table */
+            uint32_t scl = ((uint32_t)_g_oclkHz[o] * 2 * midkhz) / _g_iclkKhz[i];
+
+            if (scl <= hz && scl > best)
+            {
+                best = scl;
+                iclk = _g_iclkSel[i];
+                oclk = o;
+            }
+        }
+    }
+
+    /* Nothing's slow enough, so it gets the slowest there is */
+    if (!best)
+        best = ((uint32_t)_g_oclkHz[OCLK3] * 2 * midkhz) / _g_iclkKhz[sizeof(_g_iclkSel) - 1];
+
+    i2c_init(iclk, oclk);
+
+    return best;
+}
+
+/* Gets the bus back after a transaction has been abandoned part way.
+ *
+ * Clearing ESO resets the PCF8584's serial interface, after which it
+ * is set up again as per i2c_init() and a STOP is sent. A slave left
+ * holding SDA low will let go at that point in most cases. The PCF8584
+ * has no way of clocking SCL by hand, so one which doesn't needs a
+ * power cycle.
+ */
+void i2c_bus_recover(void)
+{
+    boot_require(_g_i2cDrv);
+
+    outp(PCF8584_S1, S1_PIN);
+
+    outp(PCF8584_S1, S1_PIN | S1_S0SEL);
+    outp(PCF8584_SX, 0x01);
+    outp(PCF8584_S1, S1_PIN | S1_S2SEL);
+    outp(PCF8584_SX, _g_i2cClock);
+
+    outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+}
+
 bool i2c_read_byte(uint8_t devaddr, uint8_t *data)
 {
     uint8_t s1reg;
     bool ret = true;
 
+    boot_require(_g_i2cDrv);
+
     /* Load slave address */
     outp(PCF8584_SX, (devaddr << 1) | 0x01);
 
@@ -109,6 +166,8 @@ bool i2c_write_byte(uint8_t devaddr, uint8_t data)
     uint8_t s1reg;
     bool ret = true;
 
+    boot_require(_g_i2cDrv);
+
     /* Wait till bus is free */
     while (!(inp(PCF8584_S1) & S1_BB));
 
@@ -147,6 +206,8 @@ bool i2c_write(uint8_t devaddr, uint8_t reg, uint8_t data)
     uint8_t s1reg;
     bool ret = true;
 
+    boot_require(_g_i2cDrv);
+
     /* Wait till bus is free */
     while (!(inp(PCF8584_S1) & S1_BB));
 
@@ -191,24 +252,20 @@ out:
 }
 
 
-bool i2c_write_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len)
-{
-    return false;
-}
-
-bool i2c_read(uint8_t devaddr, uint8_t reg, uint8_t *data)
+/* Sends hdr then data in a single START/address/STOP transaction */
+static bool i2c_write_raw(uint8_t devaddr, const uint8_t *hdr, int hdrlen, const uint8_t *data, int len)
 {
     uint8_t s1reg;
     bool ret = true;
+    int i;
 
-    if (!i2c_write_byte(devaddr, reg))
-        return false;
+    boot_require(_g_i2cDrv);
 
     /* Wait till bus is free */
     while (!(inp(PCF8584_S1) & S1_BB));
 
     /* Load slave address */
-    outp(PCF8584_SX, (devaddr << 1) | 0x01);
+    outp(PCF8584_SX, devaddr << 1);
 
     /* Send it */
     outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STA | S1_ACK);
@@ -221,65 +278,177 @@ bool i2c_read(uint8_t devaddr, uint8_t reg, uint8_t *data)
         goto out;
     }
 
-    outp(PCF8584_S1, S1_ESO);
-    inp(PCF8584_SX); /* Dummy read */
+    for (i = 0; i < hdrlen + len; i++)
+    {
+        outp(PCF8584_SX, i < hdrlen ? hdr[i] : data[i - hdrlen]);
 
-    while (((s1reg = inp(PCF8584_S1)) & S1_PIN));
+        while (((s1reg = inp(PCF8584_S1)) & S1_PIN));
 
-    if ((s1reg & S1_LRB) == S1_LRB)
-    {
-        ret = false;
-        goto out;
+        if ((s1reg & S1_LRB) == S1_LRB)
+        {
+            ret = false;
+            goto out;
+        }
     }
 
     /* Stop condition */
 out:
     outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
-    *data = inp(PCF8584_SX);
     return ret;
 }
 
-bool i2c_read_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len)
+bool i2c_write_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len)
+{
+    return i2c_write_raw(devaddr, &reg, 1, data, len);
+}
+
+/* Addresses the device and returns whether it ACKed */
+bool i2c_probe(uint8_t devaddr)
+{
+    return i2c_write_raw(devaddr, NULL, 0, NULL, 0);
+}
+
+/* Writes to a 24xx series EEPROM, one page per transaction.
+ *
+ * Writes are split on page boundaries, as the EEPROM would otherwise
+ * wrap around within the page. After each page the EEPROM is polled
+ * until it ACKs again, which it won't do until the write cycle has
+ * finished, rather than sitting out the worst case 5ms.
+ */
+bool i2c_eeprom_write(uint8_t devaddr, uint16_t addr, uint8_t addrlen, const uint8_t *data, int len, uint16_t pagesize)
+{
+    uint8_t hdr[2];
+
+    while (len > 0)
+    {
+        int thisWrite = pagesize - (addr & (pagesize - 1));
+        uint16_t attempts = 0;
+
+        if (thisWrite > len)
+            thisWrite = len;
+
+        if (addrlen == 2)
+        {
+            hdr[0] = addr >> 8;
+            hdr[1] = addr & 0xFF;
+        }
+        else
+        {
+            hdr[0] = addr & 0xFF;
+        }
+
+        if (!i2c_write_raw(devaddr, hdr, addrlen, data, thisWrite))
+            return false;
+
+        /* ACK polling */
+        while (!i2c_probe(devaddr))
+        {
+            if (++attempts >= I2C_EEPROM_POLL_ATTEMPTS)
+                return false;
+        }
+
+        addr += thisWrite;
+        data += thisWrite;
+        len -= thisWrite;
+    }
+
+    return true;
+}
+
+/* Combined transfer. Writes tx, then issues a repeated START and reads
+ * rx, all without releasing the bus in between. Either half may be
+ * omitted by passing a zero length.
+ */
+bool i2c_xfer(uint8_t devaddr, const uint8_t *tx, int txlen, uint8_t *rx, int rxlen)
 {
     uint8_t s1reg;
-    int ret = 1;
     int i;
 
-    if (!i2c_write_byte(devaddr, reg))
-        return false;
-
-    /* Load slave address */
-    outp(PCF8584_SX, (devaddr << 1) | 0x01);
+    boot_require(_g_i2cDrv);
 
     /* Wait till bus is free */
     while (!(inp(PCF8584_S1) & S1_BB));
 
-    /* Send it */
-    outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STA | S1_ACK);
-
-    for (i = 0; i <= len; i++)
+    if (txlen > 0)
     {
+        /* Load slave address */
+        outp(PCF8584_SX, devaddr << 1);
+
+        /* Send it */
+        outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STA | S1_ACK);
+
         while (((s1reg = inp(PCF8584_S1)) & S1_PIN));
 
-        if (((s1reg & S1_LRB) == S1_LRB) && (i != len))
+        if ((s1reg & S1_LRB) == S1_LRB)
+            goto fail;
+
+        for (i = 0; i < txlen; i++)
+        {
+            outp(PCF8584_SX, tx[i]);
+
+            while (((s1reg = inp(PCF8584_S1)) & S1_PIN));
+
+            if ((s1reg & S1_LRB) == S1_LRB)
+                goto fail;
+        }
+
+        if (rxlen <= 0)
         {
+            /* Stop condition */
             outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
-            return false;
+            return true;
         }
 
-        if (i == (len - 1))
+        /* Repeated start. Note the PCF8584 wants S1 written before
+         * the slave address in this case, the opposite way round
+         * to a normal start.
+         */
+        outp(PCF8584_S1, S1_ESO | S1_STA | S1_ACK);
+        outp(PCF8584_SX, (devaddr << 1) | 0x01);
+    }
+    else
+    {
+        /* Load slave address */
+        outp(PCF8584_SX, (devaddr << 1) | 0x01);
+
+        /* Send it */
+        outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STA | S1_ACK);
+    }
+
+    for (i = 0; i <= rxlen; i++)
+    {
+        while (((s1reg = inp(PCF8584_S1)) & S1_PIN));
+
+        if (((s1reg & S1_LRB) == S1_LRB) && (i == 0))
+            goto fail;
+
+        /* No ACK for the last byte */
+        if (i == (rxlen - 1))
             outp(PCF8584_S1, S1_ESO);
-        else if (i == len)
+        else if (i == rxlen)
             outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
 
         if (i)
-            data[i - 1] = inp(PCF8584_SX);
+            rx[i - 1] = inp(PCF8584_SX);
         else
-            inp(PCF8584_SX);
-
+            inp(PCF8584_SX); /* Dummy read */
     }
 
     return true;
+
+fail:
+    outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+    return false;
+}
+
+bool i2c_read(uint8_t devaddr, uint8_t reg, uint8_t *data)
+{
+    return i2c_xfer(devaddr, &reg, 1, data, 1);
+}
+
+bool i2c_read_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len)
+{
+    return i2c_xfer(devaddr, &reg, 1, data, len);
 }
 
 
@@ -290,6 +459,8 @@ bool i2c_await_flag(uint8_t addr, uint8_t mask, uint8_t *status, uint8_t attempt
     bool ret = true;
     int i;
 
+    boot_require(_g_i2cDrv);
+
     /* Load slave address */
     outp(PCF8584_SX, (addr << 1) | 0x01);
 
@@ -34,10 +34,17 @@
  *   ICLK0   = 441KHz    = 353KHz    = 220KHz
  *   ICLK2   = 220KHz    = 187KHz    = 117KHz
  *   ICLK4   = 117KHz    = 90KHz     = 58KHz
+ *
+ *   OCLK1, 2 and 3 divide these by 2, 8 and 60 respectively.
+ *
+ *   i2c_set_speed_hz() works out which combination gets closest to
+ *   (without going over) the requested speed at the detected CPU clock.
+ *   If even ICLK4/OCLK3 is too fast, that's what it sets, and returns.
  */
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "boot.h"
 
 #define ICLK4        0x1C
 #define ICLK3        0x18
@@ -50,7 +57,18 @@
 #define OCLK1        0x01
 #define OCLK0        0x00
 
+/* Standard mode */
+#define I2C_DEFAULT_HZ      100000UL
+
+/* Maximum number of times to poll a 24xx EEPROM for the end of a write cycle */
+#define I2C_EEPROM_POLL_ATTEMPTS    1000
+
+/* Started at I2C_DEFAULT_HZ on first use, unless set before */
+extern boot_drv_t _g_i2cDrv;
+
 void i2c_init(uint8_t iclkdiv, uint8_t oclkdiv);
+uint32_t i2c_set_speed_hz(uint32_t hz);
+void i2c_bus_recover(void);
 
 bool i2c_read(uint8_t devaddr, uint8_t reg, uint8_t *data);
 bool i2c_write(uint8_t devaddr, uint8_t reg, uint8_t data);
@@ -61,4 +79,8 @@ bool i2c_read_byte(uint8_t addr, uint8_t *ret);
 bool i2c_read_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len);
 bool i2c_write_buf(uint8_t devaddr, uint8_t reg, uint8_t *data, int len);
 
+bool i2c_xfer(uint8_t devaddr, const uint8_t *tx, int txlen, uint8_t *rx, int rxlen);
+bool i2c_probe(uint8_t devaddr);
+bool i2c_eeprom_write(uint8_t devaddr, uint16_t addr, uint8_t addrlen, const uint8_t *data, int len, uint16_t pagesize);
+
 bool i2c_await_flag(uint8_t addr, uint8_t mask, uint8_t *ret, uint8_t attempts);
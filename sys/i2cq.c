@@ -0,0 +1,279 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Interrupt driven PCF8584 transaction queue
+ *
+ *   The blocking functions in i2c.c spin on PIN and BB for every byte.
+ *   This instead moves a queue of transactions along one byte per
+ *   PCF8584 interrupt, so the main loop keeps running while slow
+ *   devices respond.
+ *
+ *   i2cq_init() registers i2cq_interrupt() for I2CQ_INT_STATUS with
+ *   irq.c, so the app's interrupt_handler() must call irq_dispatch().
+ *   Timeouts are counted by a systime.c timer, so systime_init() has to
+ *   have been called first, and the main loop has to call
+ *   systime_process() (sched_run() does). Both the timeouts and any bus
+ *   recovery then happen in main loop context. Completed transactions
+ *   have their callbacks run from i2cq_process(), also in the main loop.
+ *
+ *   Don't mix the blocking i2c_* calls with this while it's busy.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "eod_io.h"
+#include "eod_map.h"
+#include "i2c.h"
+#include "i2cq.h"
+#include "irq.h"
+#include "systime.h"
+#include "pcf8584.h"
+
+/* Internal transaction states */
+#define ST_WAIT_BUS     0
+#define ST_TX           1
+#define ST_RX           2
+
+#if I2CQ_INT_STATUS == STATUS_EXTINTA
+#define I2CQ_INT_PIN    (1 << 2)
+#else
+#define I2CQ_INT_PIN    (1 << 3)
+#endif
+
+static i2cq_txn_t *_g_head;
+static i2cq_txn_t *_g_tail;
+static i2cq_txn_t *_g_doneHead;
+static i2cq_txn_t *_g_doneTail;
+static systime_timer_t _g_pollTimer;
+
+static void i2cq_start(void);
+static void i2cq_poll(void *arg);
+
+void i2cq_init(void)
+{
+    boot_require(_g_i2cDrv);
+
+    _g_head = NULL;
+    _g_tail = NULL;
+    _g_doneHead = NULL;
+    _g_doneTail = NULL;
+
+    /* INT pin in, and enable the external interrupt it's wired to */
+    cpld_write(TRISA, I2CQ_INT_PIN, I2CQ_INT_PIN);
+    cpld_direct_write(STATUS, ~I2CQ_INT_STATUS);
+    irq_register(I2CQ_INT_STATUS, i2cq_interrupt);
+    cpld_write_atomic(CONFIG, I2CQ_INT_CONFIG, I2CQ_INT_CONFIG);
+
+    systime_timer_init(&_g_pollTimer, i2cq_poll, NULL);
+    systime_timer_start(&_g_pollTimer, I2CQ_POLL_MS, I2CQ_POLL_MS);
+}
+
+/* Called with interrupts off */
+static void i2cq_finish(uint8_t result)
+{
+    i2cq_txn_t *txn = _g_head;
+
+    _g_head = txn->next;
+    if (!_g_head)
+        _g_tail = NULL;
+
+    txn->result = result;
+    txn->next = NULL;
+
+    if (_g_doneTail)
+        _g_doneTail->next = txn;
+    else
+        _g_doneHead = txn;
+
+    _g_doneTail = txn;
+
+    i2cq_start();
+}
+
+/* Called with interrupts off */
+static void i2cq_start(void)
+{
+    i2cq_txn_t *txn = _g_head;
+
+    if (!txn || txn->state != ST_WAIT_BUS)
+        return;
+
+    /* Bus not free yet. i2cq_poll() or i2cq_process() will try again. */
+    if (!(inp(PCF8584_S1) & S1_BB))
+        return;
+
+    txn->pos = 0;
+
+    if (txn->txlen > 0)
+    {
+        outp(PCF8584_SX, txn->devaddr << 1);
+        txn->state = ST_TX;
+    }
+    else
+    {
+        outp(PCF8584_SX, (txn->devaddr << 1) | 0x01);
+        txn->state = ST_RX;
+    }
+
+    outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_ENI | S1_STA | S1_ACK);
+}
+
+void i2cq_submit(i2cq_txn_t *txn)
+{
+    uint16_t gint;
+
+    txn->result = I2CQ_PENDING;
+    txn->state = ST_WAIT_BUS;
+    txn->elapsed = 0;
+    txn->next = NULL;
+
+    gint = cpld_int_disable();
+
+    if (_g_tail)
+        _g_tail->next = txn;
+    else
+        _g_head = txn;
+
+    _g_tail = txn;
+
+    i2cq_start();
+
+    cpld_int_restore(gint);
+}
+
+/* PCF8584 has finished a byte. Called from irq_dispatch() */
+void i2cq_interrupt(void)
+{
+    i2cq_txn_t *txn = _g_head;
+    uint8_t s1reg = inp(PCF8584_S1);
+
+    if (!txn || txn->state == ST_WAIT_BUS || (s1reg & S1_PIN))
+        return;
+
+    if (txn->state == ST_TX)
+    {
+        if ((s1reg & S1_LRB) == S1_LRB)
+        {
+            outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+            i2cq_finish(I2CQ_NACK);
+        }
+        else if (txn->pos < txn->txlen)
+        {
+            outp(PCF8584_SX, txn->tx[txn->pos++]);
+        }
+        else if (txn->rxlen > 0)
+        {
+            /* Repeated start */
+            outp(PCF8584_S1, S1_ESO | S1_ENI | S1_STA | S1_ACK);
+            outp(PCF8584_SX, (txn->devaddr << 1) | 0x01);
+            txn->state = ST_RX;
+            txn->pos = 0;
+        }
+        else
+        {
+            outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+            i2cq_finish(I2CQ_OK);
+        }
+    }
+    else
+    {
+        int i = txn->pos++;
+
+        if (i == 0 && (s1reg & S1_LRB) == S1_LRB)
+        {
+            outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+            i2cq_finish(I2CQ_NACK);
+            return;
+        }
+
+        /* Same sequence as i2c_xfer() */
+        if (i == (txn->rxlen - 1))
+            outp(PCF8584_S1, S1_ESO | S1_ENI);
+        else if (i == txn->rxlen)
+            outp(PCF8584_S1, S1_PIN | S1_ESO | S1_DATASEL | S1_STO | S1_ACK);
+
+        if (i)
+            txn->rx[i - 1] = inp(PCF8584_SX);
+        else
+            inp(PCF8584_SX); /* Dummy read */
+
+        if (i == txn->rxlen)
+            i2cq_finish(I2CQ_OK);
+    }
+}
+
+/* Every I2CQ_POLL_MS, from systime_process() in the main loop */
+static void i2cq_poll(void *arg)
+{
+    i2cq_txn_t *txn;
+    uint16_t gint;
+
+    (void)arg;
+
+    gint = cpld_int_disable();
+
+    txn = _g_head;
+
+    /* Only the transaction at the front is charged for the time */
+    if (txn && txn->timeout)
+    {
+        txn->elapsed += I2CQ_POLL_MS;
+
+        if (txn->elapsed >= txn->timeout)
+        {
+            /* Device or bus stuck. Give up and get the bus back. */
+            i2c_bus_recover();
+            i2cq_finish(I2CQ_TIMEOUT);
+        }
+    }
+
+    i2cq_start();
+
+    cpld_int_restore(gint);
+}
+
+/* Runs callbacks for completed transactions. Called from the main loop */
+void i2cq_process(void)
+{
+    i2cq_txn_t *done;
+    uint16_t gint;
+
+    gint = cpld_int_disable();
+    done = _g_doneHead;
+    _g_doneHead = NULL;
+    _g_doneTail = NULL;
+    i2cq_start();
+    cpld_int_restore(gint);
+
+    while (done)
+    {
+        i2cq_txn_t *next = done->next;
+
+        /* Callback may resubmit the same transaction */
+        if (done->callback)
+            done->callback(done);
+
+        done = next;
+    }
+}
+
+int i2cq_idle(void)
+{
+    return _g_head == NULL && _g_doneHead == NULL;
+}
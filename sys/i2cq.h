@@ -0,0 +1,74 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Interrupt driven PCF8584 transaction queue
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __I2CQ_H__
+#define __I2CQ_H__
+
+#include <stdint.h>
+#include "eod_map.h"
+
+/* The PCF8584's INT output must be wired to one of the CPLD's external
+ * interrupt inputs. GFP3 (EXTINTB) by default, as the Ethernet shield
+ * already occupies GFP2. Define these before building to use EXTINTA.
+ */
+#ifndef I2CQ_INT_STATUS
+#define I2CQ_INT_STATUS     STATUS_EXTINTB
+#define I2CQ_INT_CONFIG     CONFIG_EXTINTB
+#endif /* I2CQ_INT_STATUS */
+
+/* Transaction results */
+#define I2CQ_PENDING        0
+#define I2CQ_OK             1
+#define I2CQ_NACK           2
+#define I2CQ_TIMEOUT        3
+
+/* How often timeouts are checked, and a busy bus retried */
+#define I2CQ_POLL_MS        10
+
+struct i2cq_txn;
+typedef void (*i2cq_callback_t)(struct i2cq_txn *txn);
+
+typedef struct i2cq_txn
+{
+    /* Filled in by the caller */
+    uint8_t devaddr;
+    const uint8_t *tx;
+    int txlen;
+    uint8_t *rx;
+    int rxlen;
+    uint16_t timeout;           /* In ms, to I2CQ_POLL_MS. 0 = forever */
+    i2cq_callback_t callback;   /* Run from i2cq_process(). May be NULL */
+    void *ctx;
+
+    /* Owned by the queue until completed */
+    volatile uint8_t result;
+    uint8_t state;
+    int pos;
+    uint16_t elapsed;           /* ms spent at the front of the queue */
+    struct i2cq_txn *next;
+} i2cq_txn_t;
+
+void i2cq_init(void);
+void i2cq_submit(i2cq_txn_t *txn);
+void i2cq_interrupt(void);
+void i2cq_process(void);
+int i2cq_idle(void);
+
+#endif /* __I2CQ_H__ */
@@ -0,0 +1,258 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Interrupt dispatch
+ *
+ *   Drivers register a handler for each STATUS flag they own, and the
+ *   app's interrupt_handler() just calls irq_dispatch(). nm_interrupt
+ *   in cstrt086.asm has already cleared CONFIG_GINT by then, and sets it
+ *   again afterwards, so nothing here touches it.
+ *
+ *   Flags are acknowledged here, before the handler runs, so anything
+ *   flagged again while it's running raises another NMI when GINT is
+ *   put back. The UART flags follow the UARTs' own INT pins, and clear
+ *   when the UART has been serviced.
+ *
+ *   Handlers run in a fixed order: the timer first, as it's the most
+ *   sensitive to latency, then the UARTs before their FIFOs overrun,
+ *   then the external interrupts and PORTA. Flags with no handler are
+ *   acknowledged and counted, so they don't come straight back.
+ *
+ *   TIMER can't be read back, and there's nothing else on the board to
+ *   timestamp with, so how long handlers take, and how long they wait,
+ *   can't be measured from in here. What can be counted, once
+ *   irq_stats_enable() is called, is how often each source had to queue
+ *   behind another, and how often it was flagged again before its own
+ *   handler had finished. The latter means the handler is falling
+ *   behind, and for a UART, that its FIFO is heading for an overrun.
+ *
+ *   For real times, irq_set_probe() raises an output for as long as
+ *   irq_dispatch() runs, for a scope or logic analyser to watch
+ *   alongside the interrupt lines. That register is then written from
+ *   the interrupt, so has to be in CPLD_SHARED_REGS (see eod_io.h) or
+ *   left alone by the main loop.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "eod_io.h"
+#include "eod_map.h"
+#include "irq.h"
+
+#define IRQ_NUM_FLAGS       8
+
+/* Cleared by servicing the UART, not by writing STATUS */
+#define IRQ_SELF_CLEARING   (STATUS_UARTAF | STATUS_UARTBF | STATUS_UARTCF | STATUS_UARTDF)
+
+/* Priority order, highest first, as STATUS bit numbers */
+static const uint8_t _g_irqOrder[IRQ_NUM_FLAGS] =
+{
+    0,  /* STATUS_TMF */
+    2,  /* STATUS_UARTAF */
+    3,  /* STATUS_UARTBF */
+    4,  /* STATUS_UARTCF */
+    5,  /* STATUS_UARTDF */
+    6,  /* STATUS_EXTINTA */
+    7,  /* STATUS_EXTINTB */
+    1   /* STATUS_PORTAF */
+};
+
+/* Indexed by bit number in STATUS */
+static irq_handler_t _g_irqHandlers[IRQ_NUM_FLAGS];
+static irq_handler_t _g_irqTimerHook;
+static uint16_t _g_irqSpurious;
+
+static irq_stats_t _g_irqStats[IRQ_NUM_FLAGS];
+static uint8_t _g_irqStatsOn;
+static uint8_t _g_irqProbeReg;
+static uint16_t _g_irqProbeMask;
+
+static const char *_g_irqNames[IRQ_NUM_FLAGS] =
+{
+    "TMF", "PORTAF", "UARTAF", "UARTBF", "UARTCF", "UARTDF", "EXTINTA", "EXTINTB"
+};
+
+static int irq_flag_bit(uint16_t flag)
+{
+    int bit;
+
+    for (bit = 0; bit < IRQ_NUM_FLAGS; bit++)
+    {
+        if (flag == (1 << bit))
+            return bit;
+    }
+
+    return -1;
+}
+
+/* Replaces whatever was registered for flag before */
+void irq_register(uint16_t flag, irq_handler_t handler)
+{
+    int bit = irq_flag_bit(flag);
+
+    /* Near pointer, so a single word write. Safe with interrupts on. */
+    if (bit >= 0)
+        _g_irqHandlers[bit] = handler;
+}
+
+void irq_unregister(uint16_t flag)
+{
+    irq_register(flag, NULL);
+}
+
+void irq_set_timer_hook(irq_handler_t hook)
+{
+    _g_irqTimerHook = hook;
+}
+
+/* Called from interrupt_handler() */
+void irq_dispatch(void)
+{
+    uint16_t status = cpld_read(STATUS) & STATUS_MASK;
+    uint16_t ack;
+    uint8_t ran = 0;
+    int i;
+
+    if (!status)
+        return;
+
+    if (_g_irqProbeMask)
+        cpld_write(_g_irqProbeReg, _g_irqProbeMask, _g_irqProbeMask);
+
+    ack = status & ~IRQ_SELF_CLEARING;
+
+    if (ack)
+        cpld_direct_write(STATUS, ~ack);
+
+    if ((status & STATUS_TMF) && _g_irqTimerHook)
+        _g_irqTimerHook();
+
+    for (i = 0; i < IRQ_NUM_FLAGS; i++)
+    {
+        uint8_t bit = _g_irqOrder[i];
+        uint16_t flag = 1 << bit;
+        irq_handler_t handler;
+
+        if (!(status & flag))
+            continue;
+
+        handler = _g_irqHandlers[bit];
+
+        if (!handler)
+        {
+            _g_irqSpurious++;
+            continue;
+        }
+
+        handler();
+
+        if (_g_irqStatsOn)
+        {
+            irq_stats_t *stats = &_g_irqStats[bit];
+
+            stats->count++;
+
+            if (ran)
+                stats->queued++;
+
+            if (cpld_read(STATUS) & flag)
+                stats->again++;
+        }
+
+        ran = 1;
+    }
+
+    if (_g_irqProbeMask)
+        cpld_write(_g_irqProbeReg, _g_irqProbeMask, 0);
+}
+
+uint16_t irq_spurious_count(void)
+{
+    return _g_irqSpurious;
+}
+
+/* Counting costs a STATUS read after every handler, so is off by default */
+void irq_stats_enable(int enable)
+{
+    _g_irqStatsOn = enable ? 1 : 0;
+}
+
+void irq_get_stats(uint16_t flag, irq_stats_t *stats)
+{
+    int bit = irq_flag_bit(flag);
+    uint16_t gint;
+
+    if (bit < 0)
+        return;
+
+    gint = cpld_int_disable();
+    *stats = _g_irqStats[bit];
+    cpld_int_restore(gint);
+}
+
+void irq_reset_stats(void)
+{
+    uint16_t gint = cpld_int_disable();
+    int i;
+
+    for (i = 0; i < IRQ_NUM_FLAGS; i++)
+    {
+        _g_irqStats[i].count = 0;
+        _g_irqStats[i].queued = 0;
+        _g_irqStats[i].again = 0;
+    }
+
+    cpld_int_restore(gint);
+}
+
+void irq_dump(void)
+{
+    int i;
+
+    printf("%-8s %10s %10s %10s\r\n", "Source", "Count", "Queued", "Again");
+
+    for (i = 0; i < IRQ_NUM_FLAGS; i++)
+    {
+        uint8_t bit = _g_irqOrder[i];
+        irq_stats_t stats;
+
+        if (!_g_irqHandlers[bit])
+            continue;
+
+        irq_get_stats(1 << bit, &stats);
+
+        printf("%-8s %10lu %10lu %10lu\r\n", _g_irqNames[bit], stats.count, stats.queued, stats.again);
+    }
+
+    printf("Spurious: %u\r\n", _g_irqSpurious);
+}
+
+/* mask 0 turns it off */
+void irq_set_probe(uint8_t reg, uint16_t mask)
+{
+    uint16_t gint = cpld_int_disable();
+
+    if (_g_irqProbeMask)
+        cpld_write(_g_irqProbeReg, _g_irqProbeMask, 0);
+
+    _g_irqProbeReg = reg;
+    _g_irqProbeMask = mask;
+
+    cpld_int_restore(gint);
+}
@@ -0,0 +1,58 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Interrupt dispatch
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __IRQ_H__
+#define __IRQ_H__
+
+#include <stdint.h>
+
+typedef void (*irq_handler_t)(void);
+
+typedef struct
+{
+    uint32_t count;         /* Times the handler has run */
+    uint32_t queued;        /* Times it had to wait for a higher priority handler */
+    uint32_t again;         /* Times it was flagged again before its handler returned */
+} irq_stats_t;
+
+/* CS:IP the current interrupt arrived at, saved by nm_interrupt */
+extern uint16_t _g_irqIp;
+extern uint16_t _g_irqCs;
+
+/* flag is one of the STATUS_* interrupt flags */
+void irq_register(uint16_t flag, irq_handler_t handler);
+void irq_unregister(uint16_t flag);
+
+/* Called on every STATUS_TMF ahead of its handler, whoever owns TIMER */
+void irq_set_timer_hook(irq_handler_t hook);
+
+void irq_dispatch(void);
+
+uint16_t irq_spurious_count(void);
+
+void irq_stats_enable(int enable);
+void irq_get_stats(uint16_t flag, irq_stats_t *stats);
+void irq_reset_stats(void);
+void irq_dump(void);
+
+/* Drives mask high in reg for as long as irq_dispatch() runs */
+void irq_set_probe(uint8_t reg, uint16_t mask);
+
+#endif /* __IRQ_H__ */
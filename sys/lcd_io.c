@@ -2,7 +2,17 @@
  *   8OD - Arduino form factor i8086 based SBC
  *   Matthew Millman (tech.mattmillman.com)
  *
- *   I/O mapped HD44780 LCD driver, for the 8OD LCD half shield
+ *   HD44780 LCD driver, for 40x4 (dual controller) displays
+ *
+ *   The display can be on one of two buses:
+ *
+ *   lcd_mapped_bus: the 8OD LCD half shield, I/O mapped at
+ *   EXT_LOWIO_BASE, where the busy flag can be read back.
+ *
+ *   lcd_gpio_bus: bit-banged through PORTD (D0-7 = data, D8 = E1,
+ *   D9 = E2, D10 = RS). R/W is tied low, so every write is followed by
+ *   a delay long enough for the slowest controller, scaled to the CPU
+ *   clock.
  *
  *   This is free software: you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
@@ -26,171 +36,663 @@
 #include "eod_io.h"
 #include "lcd_io.h"
 #include "util.h"
+#include "clock.h"
+
+/* Register select, in the order the half shield maps them */
+#define LCD1_CMD            0x00
+#define LCD1_DATA           0x01
+#define LCD2_CMD            0x02
+#define LCD2_DATA           0x03
+#define LCD_RS              0x01
 
-#define LCD1_CMD_ADDR       (EXT_LOWIO_BASE + 0x00)
-#define LCD1_DATA_ADDR      (EXT_LOWIO_BASE + 0x01)
-#define LCD2_CMD_ADDR       (EXT_LOWIO_BASE + 0x02)
-#define LCD2_DATA_ADDR      (EXT_LOWIO_BASE + 0x03)
 #define LCD_BACKLIGHT_ADDR  (EXT_LOWIO_BASE + 0x04)
 
+#define GPIO_DATA_MASK      0x00FF
+#define GPIO_E1             (1 << 8)
+#define GPIO_E2             (1 << 9)
+#define GPIO_RS             (1 << 10)
+#define GPIO_MASK           (GPIO_DATA_MASK | GPIO_E1 | GPIO_E2 | GPIO_RS)
+
 #define CMD_CLEAR           0x01
 #define CMD_HOME            0x02
 #define CMD_ONOFF           0x08
+#define CMD_SHIFT           0x10
 #define CMD_FUNCTIONSET     0x20
 
 #define DISP_ON             0x04
 #define MODE_8BIT           0x10
 #define MODE_2LINE          0x08
+#define SHIFT_DISPLAY       0x08
 
 #define CMD_DDADDR          0x80
 #define CMD_CGADDR          0x40
 
 #define STATUS_BUSY         0x80
 
-static char lcd_address_from_idx(uint8_t idx);
+/* Each controller's DDRAM address counter */
+#define AC_UNKNOWN          0xFF
+
+#define LCD_CMD(disp, cmd)  lcd_enqueue((disp) ? LCD2_CMD : LCD1_CMD, cmd)
+#define LCD_DATA(disp, data) lcd_enqueue((disp) ? LCD2_DATA : LCD1_DATA, data)
 
-#define LCD1_CMD(cmd) do { \
-        outp(LCD1_CMD_ADDR, cmd); \
-        while (inp(LCD1_CMD_ADDR) & STATUS_BUSY); \
-} while (0)
+#define lcd_reg_disp(reg)   ((reg) >> 1)
 
-#define LCD2_CMD(cmd) do { \
-        outp(LCD2_CMD_ADDR, cmd); \
-        while (inp(LCD2_CMD_ADDR) & STATUS_BUSY); \
-} while (0)
+static void lcd_mapped_init(void);
+static void lcd_mapped_write(uint8_t reg, uint8_t byte);
+static int lcd_mapped_busy(uint8_t disp);
 
-#define LCD1_DATA(cmd) do { \
-        outp(LCD1_DATA_ADDR, cmd); \
-        while (inp(LCD1_CMD_ADDR) & STATUS_BUSY); \
-} while (0)
+static void lcd_gpio_init(void);
+static void lcd_gpio_write(uint8_t reg, uint8_t byte);
+static int lcd_gpio_busy(uint8_t disp);
 
-#define LCD2_DATA(cmd) do { \
-        outp(LCD2_DATA_ADDR, cmd); \
-        while (inp(LCD2_CMD_ADDR) & STATUS_BUSY); \
-} while (0)
+const lcd_bus_t lcd_mapped_bus =
+{
+    &lcd_mapped_init,
+    &lcd_mapped_write,
+    &lcd_mapped_busy
+};
+
+const lcd_bus_t lcd_gpio_bus =
+{
+    &lcd_gpio_init,
+    &lcd_gpio_write,
+    &lcd_gpio_busy
+};
+
+static const lcd_bus_t *_g_lcdBus = &lcd_mapped_bus;
+
+/* Cells are numbered 0 - 159, row by row, the same as lcd_ddram.
+ * Rows 0 and 1 are on the first controller, 2 and 3 on the second.
+ * They're always where they appear on the display, whatever the
+ * controller's display shift.
+ */
+#define lcd_cell_disp(idx)  ((idx) >= (LCD_COLS * 2))
 
 uint8_t lcd_ddram;
 
+static char _g_lcdFb[LCD_CELLS];    /* What we want displayed */
+static char _g_lcdShown[LCD_CELLS]; /* What's actually displayed, or will be once the queue empties */
+static uint8_t _g_lcdAc[2];
+static uint8_t _g_lcdShift[2];      /* Columns each controller's display is shifted left by */
+static uint8_t _g_lcdScrolled[LCD_ROWS]; /* Columns each row has scrolled since it was loaded */
+
+/* Glyph cache, per controller */
+#define GLYPH_SLOTS         8
+
+static uint8_t _g_lcdGlyphId[2][GLYPH_SLOTS];
+static uint16_t _g_lcdGlyphUsed[2][GLYPH_SLOTS];
+static uint8_t _g_lcdGlyphValid[2];
+static uint16_t _g_lcdGlyphTick;
+
+/*   Output queue
+ *
+ *   Nothing waits on the busy flag any more. Every byte for either
+ *   controller is queued, and lcd_poll() sends them in order for as long
+ *   as the controller each is for isn't busy. 8-bit indexes wrap the
+ *   queue by themselves.
+ *
+ *   In async mode (lcd_set_async()) the lcd_*() calls return as soon as
+ *   they've queued their bytes, and the app must call lcd_poll() from
+ *   its main loop or timer interrupt. Otherwise each call drains the
+ *   queue before returning, as the driver always used to.
+ */
+static uint8_t _g_lcdQReg[256];
+static uint8_t _g_lcdQByte[256];
+static volatile uint8_t _g_lcdQHead;
+static volatile uint8_t _g_lcdQTail;
+static volatile uint8_t _g_lcdPolling;
+static uint8_t _g_lcdAsync;
+
+/* Returns non-zero while there's still something queued */
+int lcd_poll(void)
+{
+    /* Already running in the main loop, and we've interrupted it */
+    if (_g_lcdPolling)
+        return 1;
+
+    _g_lcdPolling = 1;
+
+    while (_g_lcdQTail != _g_lcdQHead)
+    {
+        uint8_t reg = _g_lcdQReg[_g_lcdQTail];
+
+        if (_g_lcdBus->busy(lcd_reg_disp(reg)))
+            break;
+
+        _g_lcdBus->write(reg, _g_lcdQByte[_g_lcdQTail]);
+        _g_lcdQTail++;
+    }
+
+    _g_lcdPolling = 0;
+
+    return _g_lcdQTail != _g_lcdQHead;
+}
+
+void lcd_sync(void)
+{
+    while (lcd_poll());
+}
+
+void lcd_set_async(int async)
+{
+    _g_lcdAsync = async;
+}
+
+/* Must be called before lcd_init() */
+void lcd_set_bus(const lcd_bus_t *bus)
+{
+    _g_lcdBus = bus;
+}
+
+static void lcd_enqueue(uint8_t reg, uint8_t byte)
+{
+    /* Full, so there's no choice but to wait for some of it to go */
+    while ((uint8_t)(_g_lcdQHead + 1) == _g_lcdQTail)
+        lcd_poll();
+
+    _g_lcdQReg[_g_lcdQHead] = reg;
+    _g_lcdQByte[_g_lcdQHead] = byte;
+    _g_lcdQHead++;
+}
+
+/* End of every public call */
+static void lcd_kick(void)
+{
+    if (_g_lcdAsync)
+        lcd_poll();
+    else
+        lcd_sync();
+}
+
+/* In 2 line mode the address counter skips from 0x27 to 0x40 and back */
+static uint8_t lcd_ac_next(uint8_t addr)
+{
+    addr++;
+
+    if (addr == 0x28)
+        return 0x40;
+
+    if (addr == 0x68)
+        return 0x00;
+
+    return addr;
+}
+
+/* Each 40 column row is one full DDRAM line, so shifting the display
+ * rotates every row of that controller.
+ */
+static uint8_t lcd_cell_addr(uint8_t idx)
+{
+    uint8_t col = (idx % LCD_COLS) + _g_lcdShift[lcd_cell_disp(idx)];
+
+    if (col >= LCD_COLS)
+        col -= LCD_COLS;
+
+    return (((idx % (LCD_COLS * 2)) >= LCD_COLS) ? 0x40 : 0x00) + col;
+}
+
+/* Only sends the DDRAM address if the controller isn't there already */
+static void lcd_seek(uint8_t idx)
+{
+    uint8_t disp = lcd_cell_disp(idx);
+    uint8_t addr = lcd_cell_addr(idx);
+
+    if (_g_lcdAc[disp] != addr)
+    {
+        LCD_CMD(disp, CMD_DDADDR | addr);
+        _g_lcdAc[disp] = addr;
+    }
+}
+
+static void lcd_put_cell(uint8_t idx, char c)
+{
+    uint8_t disp = lcd_cell_disp(idx);
+
+    lcd_seek(idx);
+    LCD_DATA(disp, (uint8_t)c);
+
+    _g_lcdAc[disp] = lcd_ac_next(_g_lcdAc[disp]);
+    _g_lcdShown[idx] = c;
+}
+
 void lcd_init(void)
 {
     lcd_ddram = 0x0;
 
-    LCD1_CMD(CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
-    LCD1_CMD(CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
-    LCD1_CMD(CMD_ONOFF | DISP_ON);
-    LCD1_CMD(CMD_CLEAR);
-    LCD1_CMD(CMD_HOME);
+    _g_lcdQHead = 0;
+    _g_lcdQTail = 0;
 
-    LCD2_CMD(CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
-    LCD2_CMD(CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
-    LCD2_CMD(CMD_ONOFF | DISP_ON);
-    LCD2_CMD(CMD_CLEAR);
-    LCD2_CMD(CMD_HOME);
+    _g_lcdBus->init();
 
-    outp(LCD_BACKLIGHT_ADDR, 1);
+    LCD_CMD(0, CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
+    LCD_CMD(0, CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
+    LCD_CMD(0, CMD_ONOFF | DISP_ON);
+    LCD_CMD(0, CMD_CLEAR);
+    LCD_CMD(0, CMD_HOME);
+
+    LCD_CMD(1, CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
+    LCD_CMD(1, CMD_FUNCTIONSET | MODE_8BIT | MODE_2LINE);
+    LCD_CMD(1, CMD_ONOFF | DISP_ON);
+    LCD_CMD(1, CMD_CLEAR);
+    LCD_CMD(1, CMD_HOME);
+
+    /* Always wait for this lot, whatever the mode */
+    lcd_sync();
+
+    memset(_g_lcdFb, ' ', LCD_CELLS);
+    memset(_g_lcdShown, ' ', LCD_CELLS);
+    _g_lcdAc[0] = 0x00;
+    _g_lcdAc[1] = 0x00;
+    _g_lcdShift[0] = 0;
+    _g_lcdShift[1] = 0;
+    memset(_g_lcdScrolled, 0, LCD_ROWS);
+
+    /* CGRAM is garbage at power up */
+    _g_lcdGlyphValid[0] = 0;
+    _g_lcdGlyphValid[1] = 0;
 }
 
 void lcd_string(const char *data)
 {
-    while (*data)
+    while (*data && lcd_ddram < LCD_CELLS)
     {
-        lcd_data((uint8_t)*(data));
-        data++;
+        _g_lcdFb[lcd_ddram] = *data;
+        lcd_put_cell(lcd_ddram++, *data++);
     }
+
+    lcd_kick();
 }
 
 void lcd_clear01(void)
 {
-    LCD1_CMD(CMD_CLEAR);
+    LCD_CMD(0, CMD_CLEAR);
+    memset(_g_lcdFb, ' ', LCD_COLS * 2);
+    memset(_g_lcdShown, ' ', LCD_COLS * 2);
+    _g_lcdAc[0] = 0x00;
+    _g_lcdShift[0] = 0;
+    _g_lcdScrolled[0] = 0;
+    _g_lcdScrolled[1] = 0;
+    lcd_kick();
 }
 
 void lcd_clear23(void)
 {
-    LCD2_CMD(CMD_CLEAR);
+    LCD_CMD(1, CMD_CLEAR);
+    memset(_g_lcdFb + (LCD_COLS * 2), ' ', LCD_COLS * 2);
+    memset(_g_lcdShown + (LCD_COLS * 2), ' ', LCD_COLS * 2);
+    _g_lcdAc[1] = 0x00;
+    _g_lcdShift[1] = 0;
+    _g_lcdScrolled[2] = 0;
+    _g_lcdScrolled[3] = 0;
+    lcd_kick();
 }
 
 void lcd_cgpopulate(uint8_t idx, const char *data)
 {
     uint8_t i;
 
-    LCD1_CMD((CMD_CGADDR | (idx * 8)) & ~CMD_DDADDR);
-    LCD2_CMD((CMD_CGADDR | (idx * 8)) & ~CMD_DDADDR);
+    LCD_CMD(0, (CMD_CGADDR | (idx * 8)) & ~CMD_DDADDR);
+    LCD_CMD(1, (CMD_CGADDR | (idx * 8)) & ~CMD_DDADDR);
     
     for (i = 0; i < 8; i++)
     {
-        LCD1_DATA((uint8_t)*(data));
-        LCD2_DATA((uint8_t)*(data));
+        LCD_DATA(0, (uint8_t)*(data));
+        LCD_DATA(1, (uint8_t)*(data));
         data++;
     }
 
-    lcd_address_from_idx(lcd_ddram);
+    /* Both are now pointing into CGRAM. The next write puts them back. */
+    _g_lcdAc[0] = AC_UNKNOWN;
+    _g_lcdAc[1] = AC_UNKNOWN;
+
+    /* Whatever the glyph cache had in this slot is gone */
+    _g_lcdGlyphValid[0] &= ~(1 << idx);
+    _g_lcdGlyphValid[1] &= ~(1 << idx);
+
+    lcd_kick();
+}
+
+void lcd_pos(uint8_t row, uint8_t col)
+{
+    if (row >= LCD_ROWS || col >= LCD_COLS)
+        return;
+
+    lcd_ddram = (row * LCD_COLS) + col;
+    lcd_seek(lcd_ddram);
+    lcd_kick();
+}
+
+void lcd_data(const uint8_t data)
+{
+    if (lcd_ddram == LCD_CELLS) //went off the end of the display
+        return;
+
+    _g_lcdFb[lcd_ddram] = data;
+    lcd_put_cell(lcd_ddram, data);
+
+    lcd_ddram++;
+
+    lcd_kick();
+}
+
+/*   Shadow framebuffer
+ *
+ *   lcd_fb_*() only change the copy in RAM. lcd_flush() then compares it
+ *   with what's on the display and sends just the cells which differ,
+ *   only moving the address counter where a run of changes is broken.
+ */
+void lcd_fb_clear(void)
+{
+    memset(_g_lcdFb, ' ', LCD_CELLS);
+}
+
+void lcd_fb_putc(uint8_t row, uint8_t col, char c)
+{
+    if (row >= LCD_ROWS || col >= LCD_COLS)
+        return;
+
+    _g_lcdFb[(row * LCD_COLS) + col] = c;
 }
 
-static char lcd_address_from_idx(uint8_t idx)
+/* Stops at the end of the row */
+void lcd_fb_write(uint8_t row, uint8_t col, const char *data)
 {
-    if (idx < 0x50)
+    char *cell;
+
+    if (row >= LCD_ROWS)
+        return;
+
+    cell = _g_lcdFb + (row * LCD_COLS);
+
+    while (*data && col < LCD_COLS)
+        cell[col++] = *data++;
+}
+
+void lcd_flush(void)
+{
+    uint8_t idx;
+
+    for (idx = 0; idx < LCD_CELLS; idx++)
     {
-        if (idx < 0x28)
-        {
-            LCD1_CMD(CMD_DDADDR | idx);
+        if (_g_lcdFb[idx] != _g_lcdShown[idx])
+            lcd_put_cell(idx, _g_lcdFb[idx]);
+    }
+
+    lcd_kick();
+}
+
+/*   Scrolling
+ *
+ *   Rows scroll left a column at a time, wrapping around, as a ticker.
+ *   Where it can, lcd_scroll_step() does that with a single display shift
+ *   command to the controller, rather than rewriting the row. That moves
+ *   both of the controller's rows though, so it's only used if the other
+ *   row is scrolling too, or looks no different shifted (e.g. blank).
+ *   Otherwise the row is rotated in the framebuffer and whatever changed
+ *   is sent by lcd_flush().
+ */
+static void lcd_rotate_row(char *row, uint8_t n)
+{
+    char tmp[LCD_COLS];
+
+    memcpy(tmp, row, n);
+    memmove(row, row + n, LCD_COLS - n);
+    memcpy(row + LCD_COLS - n, tmp, n);
+}
+
+static int lcd_row_uniform(const char *row)
+{
+    uint8_t col;
+
+    for (col = 1; col < LCD_COLS; col++)
+    {
+        if (row[col] != row[0])
             return 0;
-        }
-        else
-        {
-            LCD1_CMD(CMD_DDADDR | (idx + 24));
-            return 1;
-        }
     }
-    else
+
+    return 1;
+}
+
+/* Replaces a row, padding it with spaces */
+void lcd_scroll_text(uint8_t row, const char *text)
+{
+    char *cell;
+    uint8_t col;
+
+    if (row >= LCD_ROWS)
+        return;
+
+    cell = _g_lcdFb + (row * LCD_COLS);
+
+    for (col = 0; col < LCD_COLS; col++)
+        cell[col] = *text ? *text++ : ' ';
+
+    _g_lcdScrolled[row] = 0;
+
+    lcd_flush();
+}
+
+/* rows is a mask of LCD_ROW(n). Flushes any other framebuffer changes too. */
+void lcd_scroll_step(uint8_t rows)
+{
+    uint8_t disp;
+
+    for (disp = 0; disp < 2; disp++)
     {
-        if (idx < 0x78)
+        uint8_t scroll = (rows >> (disp << 1)) & 0x03;
+        char *fb = _g_lcdFb + (disp * LCD_COLS * 2);
+        char *shown = _g_lcdShown + (disp * LCD_COLS * 2);
+        uint8_t r;
+
+        if (!scroll)
+            continue;
+
+        if ((scroll == 0x03) ||
+            (scroll == 0x01 && lcd_row_uniform(shown + LCD_COLS)) ||
+            (scroll == 0x02 && lcd_row_uniform(shown)))
         {
-            LCD2_CMD(CMD_DDADDR | (idx - 80));
-            return 2;
+            LCD_CMD(disp, CMD_SHIFT | SHIFT_DISPLAY);
+
+            if (++_g_lcdShift[disp] == LCD_COLS)
+                _g_lcdShift[disp] = 0;
+
+            /* Keep the shadow copy in step with what the display just did */
+            lcd_rotate_row(shown, 1);
+            lcd_rotate_row(shown + LCD_COLS, 1);
         }
-        else
+
+        for (r = 0; r < 2; r++)
         {
-            LCD2_CMD(CMD_DDADDR | (idx - 56));
-            return 3;
+            uint8_t row = (disp << 1) + r;
+
+            if (!(scroll & (1 << r)))
+                continue;
+
+            lcd_rotate_row(fb + (r * LCD_COLS), 1);
+
+            if (++_g_lcdScrolled[row] == LCD_COLS)
+                _g_lcdScrolled[row] = 0;
         }
     }
+
+    lcd_flush();
 }
 
-void lcd_pos(uint8_t row, uint8_t col)
+/* Puts every row back where it was when it was loaded */
+void lcd_scroll_home(void)
 {
-    switch (row)
+    uint8_t disp;
+    uint8_t row;
+
+    for (disp = 0; disp < 2; disp++)
     {
-        case 0:
-            LCD1_CMD(CMD_DDADDR | (0x00 + col));
-            lcd_ddram = col; //Start of line 0
-            break;
-        case 1:
-            LCD1_CMD(CMD_DDADDR | (0x40 + col));
-            lcd_ddram = 0x28 + col; //Start of line 1
-            break;
-        case 2:
-            LCD2_CMD(CMD_DDADDR | (0x00 + col));
-            lcd_ddram = 0x50 + col; //Start of line 2
-            break;
-        case 3:
-            LCD2_CMD(CMD_DDADDR | (0x40 + col));
-            lcd_ddram = 0x78 + col; //Start of line 3
-            break;
-    }    
+        uint8_t n = _g_lcdShift[disp];
+        char *shown = _g_lcdShown + (disp * LCD_COLS * 2);
+
+        if (!n)
+            continue;
+
+        LCD_CMD(disp, CMD_HOME);
+        _g_lcdShift[disp] = 0;
+        _g_lcdAc[disp] = 0x00;
+
+        /* Rotating left by 40 - n is the same as right by n */
+        lcd_rotate_row(shown, LCD_COLS - n);
+        lcd_rotate_row(shown + LCD_COLS, LCD_COLS - n);
+    }
+
+    for (row = 0; row < LCD_ROWS; row++)
+    {
+        if (_g_lcdScrolled[row])
+            lcd_rotate_row(_g_lcdFb + (row * LCD_COLS), LCD_COLS - _g_lcdScrolled[row]);
+
+        _g_lcdScrolled[row] = 0;
+    }
+
+    lcd_flush();
 }
 
-void lcd_data(const uint8_t data)
+/*   Glyph cache
+ *
+ *   Maps the app's own glyph IDs onto each controller's 8 CGRAM slots,
+ *   so it doesn't have to manage them itself. A glyph is only uploaded
+ *   when it isn't already in the CGRAM of the controller driving the
+ *   row it's wanted on. When all 8 are taken, the least recently used
+ *   slot which isn't on the display is replaced, or failing that, the
+ *   least recently used one.
+ *
+ *   Character codes 8 - 15 show the same glyphs as 0 - 7, and are what's
+ *   handed out, so glyphs can be put in strings.
+ */
+static int lcd_glyph_on_display(uint8_t disp, uint8_t slot)
 {
-    if (lcd_ddram == 0xA0) //went off the end of the display
-        return;
-    
-    if (lcd_ddram >= 80)
-        LCD2_DATA(data);
+    const char *fb = _g_lcdFb + (disp * LCD_COLS * 2);
+    const char *shown = _g_lcdShown + (disp * LCD_COLS * 2);
+    uint8_t i;
+
+    for (i = 0; i < LCD_COLS * 2; i++)
+    {
+        if (((uint8_t)fb[i] & ~LCD_GLYPH_BASE) == slot ||
+            ((uint8_t)shown[i] & ~LCD_GLYPH_BASE) == slot)
+            return 1;
+    }
+
+    return 0;
+}
+
+static uint8_t lcd_glyph_victim(uint8_t disp)
+{
+    uint8_t victim = GLYPH_SLOTS;
+    uint8_t lru = 0;
+    uint8_t slot;
+
+    for (slot = 0; slot < GLYPH_SLOTS; slot++)
+    {
+        if (!(_g_lcdGlyphValid[disp] & (1 << slot)))
+            return slot;
+    }
+
+    for (slot = 0; slot < GLYPH_SLOTS; slot++)
+    {
+        if (_g_lcdGlyphUsed[disp][slot] < _g_lcdGlyphUsed[disp][lru])
+            lru = slot;
+
+        if (lcd_glyph_on_display(disp, slot))
+            continue;
+
+        if (victim == GLYPH_SLOTS || _g_lcdGlyphUsed[disp][slot] < _g_lcdGlyphUsed[disp][victim])
+            victim = slot;
+    }
+
+    return (victim == GLYPH_SLOTS) ? lru : victim;
+}
+
+/*   Returns the character to put on row for glyph id, uploading bitmap
+ *   (8 rows of 5 bits) to CGRAM first if needed.
+ */
+char lcd_glyph(uint8_t row, uint8_t id, const char *bitmap)
+{
+    uint8_t disp = (row >= 2);
+    uint8_t slot;
+    uint8_t i;
+
+    if (++_g_lcdGlyphTick == 0)
+    {
+        /* Wrapped. Start the ages again rather than get them backwards. */
+        memset(_g_lcdGlyphUsed, 0, sizeof(_g_lcdGlyphUsed));
+        _g_lcdGlyphTick = 1;
+    }
+
+    for (slot = 0; slot < GLYPH_SLOTS; slot++)
+    {
+        if ((_g_lcdGlyphValid[disp] & (1 << slot)) && _g_lcdGlyphId[disp][slot] == id)
+        {
+            _g_lcdGlyphUsed[disp][slot] = _g_lcdGlyphTick;
+            return LCD_GLYPH_BASE + slot;
+        }
+    }
+
+    slot = lcd_glyph_victim(disp);
+
+    LCD_CMD(disp, (CMD_CGADDR | (slot * 8)) & ~CMD_DDADDR);
+
+    for (i = 0; i < 8; i++)
+        LCD_DATA(disp, (uint8_t)bitmap[i]);
+
+    _g_lcdAc[disp] = AC_UNKNOWN;
+
+    _g_lcdGlyphId[disp][slot] = id;
+    _g_lcdGlyphUsed[disp][slot] = _g_lcdGlyphTick;
+    _g_lcdGlyphValid[disp] |= (1 << slot);
+
+    lcd_kick();
+
+    return LCD_GLYPH_BASE + slot;
+}
+
+/* I/O mapped (LCD half shield) */
+static void lcd_mapped_init(void)
+{
+    outp(LCD_BACKLIGHT_ADDR, 1);
+}
+
+static void lcd_mapped_write(uint8_t reg, uint8_t byte)
+{
+    outp(EXT_LOWIO_BASE + reg, byte);
+}
+
+static int lcd_mapped_busy(uint8_t disp)
+{
+    /* Status is read from the command register */
+    return inp(EXT_LOWIO_BASE + (disp << 1)) & STATUS_BUSY;
+}
+
+/* PORTD bit-banged */
+static void lcd_gpio_init(void)
+{
+    cpld_write(PORTD, GPIO_MASK, 0);
+}
+
+static void lcd_gpio_write(uint8_t reg, uint8_t byte)
+{
+    uint16_t e = lcd_reg_disp(reg) ? GPIO_E2 : GPIO_E1;
+
+    cpld_write(PORTD, GPIO_DATA_MASK | GPIO_RS, byte | ((reg & LCD_RS) ? GPIO_RS : 0));
+    delay_ncycles(1);
+
+    cpld_write(PORTD, e, e);
+    delay_ncycles(1);
+    cpld_write(PORTD, e, 0);
+
+    /* No busy flag, so wait as long as the datasheet says it could take */
+    if (!(reg & LCD_RS) && (byte == CMD_CLEAR || (byte & ~0x01) == CMD_HOME))
+        delay_us(1530);
     else
-        LCD1_DATA(data);
-        
-    lcd_ddram++;
-    
-    if (lcd_ddram == 0x50) //get disp 1 back to address 0x0 read for input
-        LCD1_CMD(CMD_DDADDR | 0x00);
+        delay_us(43);
+}
+
+static int lcd_gpio_busy(uint8_t disp)
+{
+    /* lcd_gpio_write() doesn't return until it's done */
+    return 0;
 }
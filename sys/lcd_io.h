@@ -20,6 +20,29 @@
 
 #include <stdint.h>
 
+#define LCD_ROWS            4
+#define LCD_COLS            40
+#define LCD_CELLS           (LCD_ROWS * LCD_COLS)
+
+#define LCD_ROW(n)          (1 << (n))
+#define LCD_ROW_ALL         0x0F
+
+/* lcd_glyph() hands out 0x08 - 0x0F, never 0x00 */
+#define LCD_GLYPH_BASE      0x08
+
+/* reg: bit 0 = RS, bit 1 = second controller */
+typedef struct
+{
+    void (*init)(void);
+    void (*write)(uint8_t reg, uint8_t byte);
+    int (*busy)(uint8_t disp);
+} lcd_bus_t;
+
+extern const lcd_bus_t lcd_mapped_bus;
+extern const lcd_bus_t lcd_gpio_bus;
+
+void lcd_set_bus(const lcd_bus_t *bus);
+
 void lcd_init(void);
 void lcd_data(const uint8_t data);
 void lcd_string(const char *data);
@@ -27,3 +50,18 @@ void lcd_pos(uint8_t row, uint8_t col);
 void lcd_cgpopulate(uint8_t idx, const char *data);
 void lcd_clear01(void);
 void lcd_clear23(void);
+
+void lcd_fb_clear(void);
+void lcd_fb_putc(uint8_t row, uint8_t col, char c);
+void lcd_fb_write(uint8_t row, uint8_t col, const char *data);
+void lcd_flush(void);
+
+void lcd_scroll_text(uint8_t row, const char *text);
+void lcd_scroll_step(uint8_t rows);
+void lcd_scroll_home(void);
+
+char lcd_glyph(uint8_t row, uint8_t id, const char *bitmap);
+
+void lcd_set_async(int async);
+int lcd_poll(void);
+void lcd_sync(void);
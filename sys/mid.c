@@ -4,6 +4,12 @@
  *
  *   Microwire Interface Device driver
  *
+ *   Every transfer runs with interrupts masked, as adccap.c converts from
+ *   the TIMER interrupt. A conversion in the middle of a main loop
+ *   transfer would change CSEL and the divider under it. The longest
+ *   hold off is mid_xfer_to_uart(), for however long the whole stream
+ *   takes.
+ *
  *   This is free software: you can redistribute it and/or modify
  *   it under the terms of the GNU General Public License as published by
  *   the Free Software Foundation, either version 2 of the License, or
@@ -23,17 +29,113 @@
 #include "eod_io.h"
 #include "mid.h"
 #include "uart.h"
+#include "clock.h"
+#include "boot.h"
 
-void mid_init(int speed)
+static uint8_t _g_midDiv[M_DEV_SPARE2 + 1];
+static uint8_t _g_midCurDiv;
+static uint8_t _g_midChosen;    /* Bit per device whose divider the app picked */
+
+static void mid_start(void);
+static boot_drv_t _g_midDrv = BOOT_DRV("mid", mid_start);
+
+static void mid_set_all(int speed)
 {
+    int dev;
+
+    boot_started(&_g_midDrv);
+
+    for (dev = 0; dev <= M_DEV_SPARE2; dev++)
+        _g_midDiv[dev] = speed & SKR_DIV_MASK;
+
     /* Sets maser mode, disables interrupt, and clock divider */
-    outp(MID_BASE + SKR, speed & SKR_DIV_MASK);
+    _g_midCurDiv = speed & SKR_DIV_MASK;
+    outp(MID_BASE + SKR, _g_midCurDiv);
+}
+
+/* Per device speeds are then set by each driver's init */
+static void mid_start(void)
+{
+    mid_set_all(M_CLK_DIV4);
+    _g_midChosen = 0;
+}
+
+/* Every device at this divider, which drivers starting later will keep */
+void mid_init(int speed)
+{
+    mid_set_all(speed);
+    _g_midChosen = (1 << (M_DEV_SPARE2 + 1)) - 1;
+}
+
+static uint8_t mid_div_for_hz(uint32_t midclk, uint32_t hz)
+{
+    uint8_t div = M_CLK_DIV4;
+
+    while (div < M_CLK_DIV128 && (midclk >> div) > hz)
+        div++;
+
+    return div;
+}
+
+/* Returns the resulting SCK */
+uint32_t mid_set_speed_hz(int dev, uint32_t hz)
+{
+    uint32_t midclk = clock_mid_hz();
+
+    boot_require(_g_midDrv);
+
+    if (dev > M_DEV_SPARE2)
+        return 0;
+
+    _g_midDiv[dev] = mid_div_for_hz(midclk, hz);
+    _g_midChosen |= (1 << dev);
+
+    return midclk >> _g_midDiv[dev];
+}
+
+/*   For drivers' init. As mid_set_speed_hz(), unless the app has already
+ *   picked this device's speed, in which case that's left alone. Returns
+ *   the SCK the device will run at either way.
+ */
+uint32_t mid_default_speed_hz(int dev, uint32_t hz)
+{
+    uint32_t midclk = clock_mid_hz();
+
+    boot_require(_g_midDrv);
+
+    if (dev > M_DEV_SPARE2)
+        return 0;
+
+    if (!(_g_midChosen & (1 << dev)))
+        _g_midDiv[dev] = mid_div_for_hz(midclk, hz);
+
+    return midclk >> _g_midDiv[dev];
+}
+
+/*   Switch to the device's divider, if it isn't already in use. Every
+ *   transfer comes through here first, so it also starts the MID for
+ *   drivers (e.g. w5100.c) which go straight to mid_xfer_x8().
+ */
+void mid_apply_speed(int dev)
+{
+    boot_require(_g_midDrv);
+
+    if (dev > M_DEV_SPARE2)
+        return;
+
+    if (_g_midDiv[dev] == _g_midCurDiv)
+        return;
+
+    _g_midCurDiv = _g_midDiv[dev];
+    outp(MID_BASE + SKR, _g_midCurDiv);
 }
 
 void mid_cfg_dev(int dev, int enabled, int clkpol, int width)
 {
     uint8_t currentPd;
 
+    boot_require(_g_midDrv);
+
     /* Impossible on this platform */
     if (dev > M_DEV_SPARE2)
         return;
@@ -75,6 +177,9 @@ void mid_xfer_x8_two(int dev, int tx1Len, uint8_t *tx1Buf, int tx2Len,
 	uint8_t *tx2Buf, int rxLen, uint8_t *rxBuf)
 {
     int pos = 0;
+    uint16_t gint = cpld_int_disable();
+
+    mid_apply_speed(dev);
 
     /* Select requested device */
     outp(MID_BASE + CSEL, ~(1 << dev));
@@ -129,12 +234,17 @@ void mid_xfer_x8_two(int dev, int tx1Len, uint8_t *tx1Buf, int tx2Len,
 
     /* De-select everything */
     outp(MID_BASE + CSEL, 0xFF);
+
+    cpld_int_restore(gint);
 }
 
 /* Untested */
 void mid_xfer_x16(int dev, int txLen, uint16_t *txBuf, int rxLen, uint16_t *rxBuf)
 {
     int pos = 0;
+    uint16_t gint = cpld_int_disable();
+
+    mid_apply_speed(dev);
 
     /* Select requested device */
     outp(MID_BASE + CSEL, ~(1 << dev));
@@ -181,6 +291,8 @@ void mid_xfer_x16(int dev, int txLen, uint16_t *txBuf, int rxLen, uint16_t *rxBu
 
     /* De-select everything */
     outp(MID_BASE + CSEL, 0xFF);
+
+    cpld_int_restore(gint);
 }
 
 /* Special IO function allowing large amounts to be streamed directly to the UART
@@ -189,10 +301,14 @@ void mid_xfer_x16(int dev, int txLen, uint16_t *txBuf, int rxLen, uint16_t *rxBu
 void mid_xfer_to_uart(int dev, int txLen, uint8_t *txBuf, uint32_t rxLen, int uart_index)
 {
     uint32_t pos = 0;
+    uint16_t gint;
 
     if (!rxLen)
         return;
 
+    gint = cpld_int_disable();
+
+    mid_apply_speed(dev);
     outp(MID_BASE + CSEL, ~(1 << dev));
 
     while (pos < txLen)
@@ -217,4 +333,6 @@ void mid_xfer_to_uart(int dev, int txLen, uint8_t *txBuf, uint32_t rxLen, int ua
     } while (pos <= rxLen);
 
     outp(MID_BASE + CSEL, 0xFF);
+
+    cpld_int_restore(gint);
 }
@@ -34,6 +34,12 @@
  *   DIV32   = 469KHz    = 375KHz    = 234KHz
  *   DIV64   = 234KHz    = 188KHz    = 117KHz
  *   DIV128  = 117KHz    = 94KHz     = 59KHz
+ *
+ *   The divider is kept per device. mid_set_speed_hz() picks the fastest
+ *   one not exceeding what the device can take at the detected CPU clock,
+ *   and it's switched in as each device is selected. Drivers only set
+ *   a default, with mid_default_speed_hz(), so whatever the app asked
+ *   for with mid_init() or mid_set_speed_hz() stands.
  */
 
 
@@ -83,7 +89,14 @@
 
 #define PD              0x0F
 
+/* Maximum SCK each device on the board tolerates */
+#define M_DEV_EEPROM_MAX_HZ 20000000UL  /* M25P80, 0x03 READ command */
+#define M_DEV_ADC_MAX_HZ    20000000UL  /* AD7490 */
+
 void mid_init(int speed);
+uint32_t mid_set_speed_hz(int dev, uint32_t hz);
+uint32_t mid_default_speed_hz(int dev, uint32_t hz);
+void mid_apply_speed(int dev);
 void mid_cfg_dev(int dev, int enabled, int clkpol, int width);
 void mid_xfer_x8_two(int dev, int tx1Len, uint8_t *tx1Buf, int tx2Len, uint8_t *tx2Buf, int rxLen, uint8_t *rxBuf);
 void mid_xfer_x16(int dev, int txLen, uint16_t *txBuf, int rxLen, uint16_t *rxBuf); /* Untested */
@@ -0,0 +1,153 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Read-only packed filesystem
+ *
+ *   Images are built on the host with tools/mkpackfs and written to
+ *   flash as-is. Lookups hash the path to a bucket, so finding a file
+ *   costs one bucket read and (almost always) one entry read, which
+ *   all come out of the block cache after the first time.
+ *
+ *   File data is read straight from the flash, bypassing the cache,
+ *   so that streaming a large file doesn't push the index out of it.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include "flash.h"
+#include "blkdev.h"
+#include "packfs.h"
+
+#define packfs_bucket_offset(fs, b) \
+    ((fs)->base + sizeof(packfs_hdr_t) + ((uint32_t)(b) * sizeof(uint16_t)))
+
+#define packfs_entry_offset(fs, e) \
+    ((fs)->base + sizeof(packfs_hdr_t) + ((uint32_t)(fs)->hdr.num_buckets * sizeof(uint16_t)) + \
+    ((uint32_t)(e) * sizeof(packfs_entry_t)))
+
+/* djb2. No multiplies, which matters on an 8086 */
+uint32_t packfs_hash(const char *path)
+{
+    uint32_t hash = 5381;
+
+    while (*path)
+        hash = ((hash << 5) + hash) + (uint8_t)*path++;
+
+    return hash;
+}
+
+int packfs_mount(packfs_t *fs, blkdev_t *bd, uint32_t base)
+{
+    fs->bd = bd;
+    fs->base = base;
+
+    if (!blkdev_read(bd, base, sizeof(packfs_hdr_t), (uint8_t *)&fs->hdr))
+        return 0;
+
+    if (fs->hdr.magic != PACKFS_MAGIC || fs->hdr.version != PACKFS_VERSION)
+        return 0;
+
+    /* num_buckets must be a power of two */
+    if (!fs->hdr.num_buckets || (fs->hdr.num_buckets & (fs->hdr.num_buckets - 1)))
+        return 0;
+
+    return 1;
+}
+
+static int packfs_name_matches(packfs_t *fs, uint32_t name_offset, const char *path)
+{
+    char name[16];
+    uint16_t len = strlen(path) + 1; /* Include the NUL */
+
+    while (len)
+    {
+        uint16_t chunk = len > sizeof(name) ? sizeof(name) : len;
+
+        if (!blkdev_read(fs->bd, fs->base + name_offset, chunk, (uint8_t *)name))
+            return 0;
+
+        if (memcmp(name, path, chunk))
+            return 0;
+
+        name_offset += chunk;
+        path += chunk;
+        len -= chunk;
+    }
+
+    return 1;
+}
+
+int packfs_open(packfs_t *fs, const char *path, packfs_file_t *file)
+{
+    packfs_entry_t entry;
+    uint32_t hash;
+    uint16_t bucket;
+    uint16_t idx;
+
+    if (strlen(path) >= PACKFS_MAX_PATH)
+        return 0;
+
+    hash = packfs_hash(path);
+    bucket = (uint16_t)hash & (fs->hdr.num_buckets - 1);
+
+    if (!blkdev_read(fs->bd, packfs_bucket_offset(fs, bucket), sizeof(uint16_t), (uint8_t *)&idx))
+        return 0;
+
+    if (idx == PACKFS_EMPTY)
+        return 0;
+
+    /* Entries are sorted by bucket, so walk until we leave this one */
+    for (; idx < fs->hdr.num_files; idx++)
+    {
+        if (!blkdev_read(fs->bd, packfs_entry_offset(fs, idx), sizeof(packfs_entry_t), (uint8_t *)&entry))
+            return 0;
+
+        if (((uint16_t)entry.hash & (fs->hdr.num_buckets - 1)) != bucket)
+            break;
+
+        if (entry.hash == hash && packfs_name_matches(fs, entry.name_offset, path))
+        {
+            /* packfs_read() goes around the cache, so check it here */
+            if (fs->base + entry.data_offset + entry.length > fs->bd->size)
+                return 0;
+
+            file->offset = fs->base + entry.data_offset;
+            file->length = entry.length;
+            file->pos = 0;
+            return 1;
+        }
+    }
+
+    return 0;
+}
+
+uint16_t packfs_read(packfs_t *fs, packfs_file_t *file, uint8_t *buf, uint16_t len)
+{
+    uint32_t remaining = file->length - file->pos;
+
+    if (len > remaining)
+        len = (uint16_t)remaining;
+
+    if (!len)
+        return 0;
+
+    fs->bd->ops->read(file->offset + file->pos, len, buf);
+    file->pos += len;
+
+    return len;
+}
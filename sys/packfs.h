@@ -0,0 +1,82 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Read-only packed filesystem
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PACKFS_H__
+#define __PACKFS_H__
+
+#include <stdint.h>
+#include "blkdev.h"
+
+/*   Image layout. All fields are little endian, all offsets are
+ *   relative to the start of the image.
+ *
+ *   packfs_hdr_t
+ *   uint16_t buckets[num_buckets]   Index of first entry in each bucket,
+ *                                   PACKFS_EMPTY if none
+ *   packfs_entry_t entries[num_files] Sorted by bucket
+ *   Names (NUL terminated)
+ *   File data
+ *
+ *   This must be kept in step with tools/mkpackfs/mkpackfs.c
+ */
+
+#define PACKFS_MAGIC        0x53464B50UL    /* "PKFS" */
+#define PACKFS_VERSION      1
+#define PACKFS_EMPTY        0xFFFF
+#define PACKFS_MAX_PATH     128
+
+typedef struct
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t num_buckets;   /* Always a power of two */
+    uint16_t num_files;
+    uint16_t reserved;
+    uint32_t image_size;
+} packfs_hdr_t;
+
+typedef struct
+{
+    uint32_t hash;
+    uint32_t name_offset;
+    uint32_t data_offset;
+    uint32_t length;
+} packfs_entry_t;
+
+typedef struct
+{
+    blkdev_t *bd;
+    uint32_t base;          /* Offset of the image in flash */
+    packfs_hdr_t hdr;
+} packfs_t;
+
+typedef struct
+{
+    uint32_t offset;        /* Absolute flash offset of the data */
+    uint32_t length;
+    uint32_t pos;
+} packfs_file_t;
+
+int packfs_mount(packfs_t *fs, blkdev_t *bd, uint32_t base);
+int packfs_open(packfs_t *fs, const char *path, packfs_file_t *file);
+uint16_t packfs_read(packfs_t *fs, packfs_file_t *file, uint8_t *buf, uint16_t len);
+uint32_t packfs_hash(const char *path);
+
+#endif /* __PACKFS_H__ */
@@ -0,0 +1,52 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   PCF8584 I2C Master registers
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PCF8584_H__
+#define __PCF8584_H__
+
+#include "eod_map.h"
+
+#define PCF8584_SX      (I2C_BASE + 0)
+#define PCF8584_S1      (I2C_BASE + 1)
+
+/* S1 Write */
+#define S1_PIN          (1 << 7)
+#define S1_ESO          (1 << 6)
+#define S1_ENI          (1 << 3)
+#define S1_STA          (1 << 2)
+#define S1_STO          (1 << 1)
+#define S1_ACK          (1 << 0)
+#define S1_ESMSK        ((1 << 5) | (1 << 4))
+/* ESO = 0 */
+#define S1_S0SEL        0
+#define S1_S3SEL        (1 << 4)
+#define S1_S2SEL        (1 << 5)
+/* ESO = 1 */
+#define S1_DATASEL      0
+
+/* S1 Read */
+#define S1_STS          (1 << 5)
+#define S1_BER          (1 << 4)
+#define S1_LRB          (1 << 3)
+#define S1_AAS          (1 << 2)
+#define S1_LAB          (1 << 1)
+#define S1_BB           (1 << 0)
+
+#endif /* __PCF8584_H__ */
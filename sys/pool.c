@@ -0,0 +1,216 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Fixed size block pools
+ *
+ *   For things which are allocated and freed over and over, where
+ *   malloc() would take time proportional to the state of the heap, and
+ *   fragment it. Each pool is a fixed number of same sized blocks in
+ *   memory the caller provides, with the free ones on a list, so taking
+ *   and returning one is a couple of pointer moves.
+ *
+ *   Pools are also kept in size order, so pool_malloc() can hand out a
+ *   block from the smallest one that fits, and pool_release() can work
+ *   out where it came from. That's a walk along however many pools
+ *   there are, which is only ever a handful.
+ *
+ *   Main loop only. Nothing here masks interrupts.
+ *
+ *   With POOL_GUARDS, each block is tagged as in use or free, and has a
+ *   canary after it. A free that finds either wrong is counted, and the
+ *   block left out of the pool rather than risk the free list.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include "pool.h"
+
+#ifdef POOL_GUARDS
+#define POOL_HEAD           2
+#define POOL_TAG_USED       0xB10C
+#define POOL_TAG_FREE       0xF4EE
+#define POOL_CANARY         0xA55A
+#else
+#define POOL_HEAD           0
+#endif /* POOL_GUARDS */
+
+#define pool_link(block)    (*(uint8_t **)((block) + POOL_HEAD))
+
+/* Smallest first */
+static pool_t *_g_poolHead;
+
+static int pool_owns(const pool_t *pool, const uint8_t *block)
+{
+    return block >= pool->base && block < pool->base + (pool->stride * pool->count);
+}
+
+/* mem must be at least POOL_MEM_WORDS(size, count) long */
+void pool_init(pool_t *pool, const char *name, uint16_t *mem, uint16_t size, uint16_t count)
+{
+    pool_t **pp;
+    uint16_t i;
+
+    pool->name = name;
+    pool->base = (uint8_t *)mem;
+    pool->size = size;
+    pool->stride = POOL_STRIDE(size);
+    pool->count = count;
+    pool->free = NULL;
+
+    /* Built backwards, so they come out in address order */
+    for (i = count; i > 0; i--)
+    {
+        uint8_t *block = pool->base + (pool->stride * (i - 1));
+
+#ifdef POOL_GUARDS
+        *(uint16_t *)block = POOL_TAG_FREE;
+#endif /* POOL_GUARDS */
+        pool_link(block) = pool->free;
+        pool->free = block;
+    }
+
+    pool->used = 0;
+    pool->high_water = 0;
+    pool->failures = 0;
+    pool->corrupt = 0;
+
+    for (pp = &_g_poolHead; *pp && (*pp)->size <= size; pp = &(*pp)->next);
+
+    pool->next = *pp;
+    *pp = pool;
+}
+
+/* NULL if it's empty */
+void *pool_alloc(pool_t *pool)
+{
+    uint8_t *block = pool->free;
+
+    if (!block)
+    {
+        pool->failures++;
+        return NULL;
+    }
+
+    pool->free = pool_link(block);
+
+    if (++pool->used > pool->high_water)
+        pool->high_water = pool->used;
+
+#ifdef POOL_GUARDS
+    *(uint16_t *)block = POOL_TAG_USED;
+    *(uint16_t *)(block + pool->stride - 2) = POOL_CANARY;
+#endif /* POOL_GUARDS */
+
+    return block + POOL_HEAD;
+}
+
+void pool_free(pool_t *pool, void *p)
+{
+    uint8_t *block;
+
+    if (!p)
+        return;
+
+    block = (uint8_t *)p - POOL_HEAD;
+
+#ifdef POOL_GUARDS
+    if (!pool_owns(pool, block) ||
+        ((uint16_t)(block - pool->base) % pool->stride) ||
+        *(uint16_t *)block != POOL_TAG_USED ||
+        *(uint16_t *)(block + pool->stride - 2) != POOL_CANARY)
+    {
+        pool->corrupt++;
+        return;
+    }
+
+    *(uint16_t *)block = POOL_TAG_FREE;
+#endif /* POOL_GUARDS */
+
+    pool_link(block) = pool->free;
+    pool->free = block;
+    pool->used--;
+}
+
+/* From the smallest pool that fits and isn't empty. NULL if none */
+void *pool_malloc(uint16_t size)
+{
+    pool_t *first = NULL;
+    pool_t *pool;
+
+    for (pool = _g_poolHead; pool; pool = pool->next)
+    {
+        if (pool->size < size)
+            continue;
+
+        if (pool->free)
+            return pool_alloc(pool);
+
+        if (!first)
+            first = pool;
+    }
+
+    /* Counted against the size class it should have come from */
+    if (first)
+        first->failures++;
+
+    return NULL;
+}
+
+void pool_release(void *p)
+{
+    pool_t *pool;
+
+    if (!p)
+        return;
+
+    for (pool = _g_poolHead; pool; pool = pool->next)
+    {
+        if (pool_owns(pool, (uint8_t *)p))
+        {
+            pool_free(pool, p);
+            return;
+        }
+    }
+}
+
+/* Every pool, smallest first, to stdout */
+void pool_dump(void)
+{
+    pool_t *pool;
+
+    printf("%-12s %6s %6s %6s %6s %6s %6s\r\n", "Pool", "Size", "Count", "Used", "High", "Fail", "Bad");
+
+    for (pool = _g_poolHead; pool; pool = pool->next)
+    {
+        printf("%-12s %6u %6u %6u %6u %6u %6u\r\n", pool->name, pool->size, pool->count,
+            pool->used, pool->high_water, pool->failures, pool->corrupt);
+    }
+}
+
+/* High water marks start again from what's in use now */
+void pool_reset_stats(void)
+{
+    pool_t *pool;
+
+    for (pool = _g_poolHead; pool; pool = pool->next)
+    {
+        pool->high_water = pool->used;
+        pool->failures = 0;
+        pool->corrupt = 0;
+    }
+}
@@ -0,0 +1,69 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Fixed size block pools
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __POOL_H__
+#define __POOL_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+/* Build with -dPOOL_GUARDS to catch overruns and double frees */
+#ifdef POOL_GUARDS
+#define POOL_OVERHEAD       4       /* Tag word in front, canary word behind */
+#else
+#define POOL_OVERHEAD       0
+#endif /* POOL_GUARDS */
+
+/* Bytes each block takes, word aligned, and never too small for the free list link */
+#define POOL_STRIDE(size)   (((((size) < sizeof(void *) ? sizeof(void *) : (size)) + 1) & ~1) + POOL_OVERHEAD)
+
+/* For declaring the memory for a pool, e.g.
+ *
+ *   static uint16_t _g_mem[POOL_MEM_WORDS(41, 4)];
+ */
+#define POOL_MEM_WORDS(size, count) ((POOL_STRIDE(size) * (count)) / sizeof(uint16_t))
+
+typedef struct pool
+{
+    const char *name;
+    uint8_t *base;
+    uint8_t *free;              /* Free list, linked through the first word of each block */
+    struct pool *next;          /* Next bigger size class */
+    uint16_t size;              /* What each block can hold */
+    uint16_t stride;
+    uint16_t count;
+    uint16_t used;
+    uint16_t high_water;
+    uint16_t failures;          /* Allocations turned away because it was empty */
+    uint16_t corrupt;           /* Frees that found a damaged or already free block */
+} pool_t;
+
+void pool_init(pool_t *pool, const char *name, uint16_t *mem, uint16_t size, uint16_t count);
+
+void *pool_alloc(pool_t *pool);
+void pool_free(pool_t *pool, void *p);
+
+void *pool_malloc(uint16_t size);
+void pool_release(void *p);
+
+void pool_dump(void);
+void pool_reset_stats(void);
+
+#endif /* __POOL_H__ */
@@ -0,0 +1,203 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Sampling profiler
+ *
+ *   On every TIMER overflow, whichever driver owns TIMER, the CS:IP that
+ *   nm_interrupt saved on the way in is counted in a histogram in far
+ *   RAM. The app's code all lives in one segment, so the histogram only
+ *   needs to cover that, one bucket per 1 << PROF_SHIFT bytes.
+ *
+ *   Nothing is sampled unless something is running TIMER (systime_init()
+ *   or adccap_start()), and the rate is whatever that is. Code which runs
+ *   with GINT off, interrupt handlers included, is never seen at all;
+ *   the sample lands just after it instead.
+ *
+ *   prof_dump() writes the histogram out over a UART as text, which
+ *   tools/profsym turns back into function names using the app.map
+ *   wlink leaves behind:
+ *
+ *     PROF <cs> <shift> <samples> <outside>
+ *     <offset> <count>
+ *     ...
+ *     END
+ *
+ *   All in hex. Only non-zero buckets are sent.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <i86.h>
+#include "eod_io.h"
+#include "eod_map.h"
+#include "uart.h"
+#include "irq.h"
+#include "prof.h"
+
+uint16_t prof_get_cs(void);
+
+#pragma aux prof_get_cs = \
+    "mov ax, cs" \
+    value [ax] \
+    modify exact [ax];
+
+static uint16_t far *_g_profHist;
+static uint16_t _g_profCs;
+static volatile uint8_t _g_profRunning;
+static prof_stats_t _g_profStats;
+
+/* seg must have PROF_SIZE bytes of far RAM to itself */
+int prof_init(uint16_t seg)
+{
+    if (seg < FAR_RAM_SEG || ((uint32_t)(seg - FAR_RAM_SEG) << 4) + PROF_SIZE > FAR_RAM_SIZE)
+        return 0;
+
+    prof_stop();
+
+    _g_profHist = (uint16_t far *)MK_FP(seg, 0);
+    _g_profCs = prof_get_cs();
+
+    prof_reset();
+    irq_set_timer_hook(prof_sample);
+
+    return 1;
+}
+
+void prof_start(void)
+{
+    if (_g_profHist)
+        _g_profRunning = 1;
+}
+
+void prof_stop(void)
+{
+    _g_profRunning = 0;
+}
+
+void prof_reset(void)
+{
+    uint8_t running = _g_profRunning;
+    uint32_t i;
+
+    if (!_g_profHist)
+        return;
+
+    _g_profRunning = 0;
+
+    for (i = 0; i < PROF_BUCKETS; i++)
+        _g_profHist[(uint16_t)i] = 0;
+
+    _g_profStats.samples = 0;
+    _g_profStats.outside = 0;
+    _g_profStats.saturated = 0;
+
+    _g_profRunning = running;
+}
+
+/* Timer hook, called from irq_dispatch() */
+void prof_sample(void)
+{
+    uint16_t far *count;
+
+    if (!_g_profRunning)
+        return;
+
+    _g_profStats.samples++;
+
+    if (_g_irqCs != _g_profCs)
+    {
+        _g_profStats.outside++;
+        return;
+    }
+
+    count = &_g_profHist[_g_irqIp >> PROF_SHIFT];
+
+    if (*count == 0xFFFF)
+        return;
+
+    if (++(*count) == 0xFFFF)
+        _g_profStats.saturated++;
+}
+
+void prof_get_stats(prof_stats_t *stats)
+{
+    uint16_t gint = cpld_int_disable();
+    *stats = _g_profStats;
+    cpld_int_restore(gint);
+}
+
+static void prof_put_hex(int index, uint32_t value, uint8_t digits)
+{
+    static const char hex[] = "0123456789ABCDEF";
+
+    while (digits--)
+        uart_putc(index, hex[(uint8_t)(value >> (digits << 2)) & 0x0F]);
+}
+
+static void prof_put_eol(int index)
+{
+    uart_putc(index, '\r');
+    uart_putc(index, '\n');
+}
+
+/* Sampling is paused while the histogram is sent, then carries on */
+void prof_dump(int index)
+{
+    uint8_t running = _g_profRunning;
+    prof_stats_t stats;
+    uint32_t i;
+
+    if (!_g_profHist)
+        return;
+
+    _g_profRunning = 0;
+    prof_get_stats(&stats);
+
+    uart_putc(index, 'P');
+    uart_putc(index, 'R');
+    uart_putc(index, 'O');
+    uart_putc(index, 'F');
+    uart_putc(index, ' ');
+    prof_put_hex(index, _g_profCs, 4);
+    uart_putc(index, ' ');
+    prof_put_hex(index, PROF_SHIFT, 1);
+    uart_putc(index, ' ');
+    prof_put_hex(index, stats.samples, 8);
+    uart_putc(index, ' ');
+    prof_put_hex(index, stats.outside, 8);
+    prof_put_eol(index);
+
+    for (i = 0; i < PROF_BUCKETS; i++)
+    {
+        uint16_t count = _g_profHist[(uint16_t)i];
+
+        if (!count)
+            continue;
+
+        prof_put_hex(index, i << PROF_SHIFT, 4);
+        uart_putc(index, ' ');
+        prof_put_hex(index, count, 4);
+        prof_put_eol(index);
+    }
+
+    uart_putc(index, 'E');
+    uart_putc(index, 'N');
+    uart_putc(index, 'D');
+    prof_put_eol(index);
+
+    _g_profRunning = running;
+}
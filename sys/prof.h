@@ -0,0 +1,49 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Sampling profiler
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __PROF_H__
+#define __PROF_H__
+
+#include <stdint.h>
+
+/* Each bucket covers 1 << PROF_SHIFT bytes of code */
+#define PROF_SHIFT          2
+#define PROF_BUCKETS        (0x10000UL >> PROF_SHIFT)
+
+/* Far RAM taken by the histogram */
+#define PROF_SIZE           (PROF_BUCKETS * sizeof(uint16_t))
+
+typedef struct
+{
+    uint32_t samples;       /* Timer ticks seen while running */
+    uint32_t outside;       /* Samples that weren't in the app's code segment */
+    uint16_t saturated;     /* Buckets that have hit 0xFFFF */
+} prof_stats_t;
+
+int prof_init(uint16_t seg);
+void prof_start(void);
+void prof_stop(void);
+void prof_reset(void);
+void prof_sample(void);
+
+void prof_get_stats(prof_stats_t *stats);
+void prof_dump(int index);
+
+#endif /* __PROF_H__ */
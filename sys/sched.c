@@ -0,0 +1,203 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Cooperative task scheduler
+ *
+ *   A task is a function which runs to completion each time it has
+ *   something to do. Interrupt handlers and other tasks hand it events
+ *   with sched_post(), and sched_sleep() posts SCHED_EV_TIMER to it later
+ *   from a systime timer. Tasks run in the order they were added, each
+ *   getting all of the events posted since it last ran.
+ *
+ *   When nothing is ready, and there are no SCHED_POLL tasks, the CPU is
+ *   halted until the next interrupt. The systime tick is one, so systime
+ *   must be running, and nothing sleeps longer than 6.25ms regardless.
+ *
+ *   CPU time is accounted by reading the systime tick count either side
+ *   of each run. Most runs are shorter than a tick, but as they start at
+ *   random points within one, the totals average out right.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+
+#include "eod_io.h"
+#include "systime.h"
+#include "sched.h"
+
+void sched_halt(void);
+
+#pragma aux sched_halt = \
+    "hlt";
+
+static sched_task_t *_g_tasks[SCHED_MAX_TASKS];
+static uint8_t _g_numTasks;
+static uint8_t _g_numPoll;
+static volatile uint16_t _g_ready;
+static uint32_t _g_idleTicks;
+static uint32_t _g_statsStart;
+
+static void sched_timer_expired(void *arg)
+{
+    sched_post((sched_task_t *)arg, SCHED_EV_TIMER);
+}
+
+void sched_init(void)
+{
+    _g_numTasks = 0;
+    _g_numPoll = 0;
+    _g_ready = 0;
+
+    sched_reset_stats();
+}
+
+/* Earlier tasks run first. Returns 0 if there's no room. */
+int sched_add(sched_task_t *task, const char *name, sched_fn_t fn, void *arg, uint8_t flags)
+{
+    if (_g_numTasks == SCHED_MAX_TASKS)
+        return 0;
+
+    task->name = name;
+    task->fn = fn;
+    task->arg = arg;
+    task->bit = 1 << _g_numTasks;
+    task->flags = flags;
+    task->events = 0;
+    task->runs = 0;
+    task->ticks = 0;
+
+    systime_timer_init(&task->timer, sched_timer_expired, task);
+
+    if (flags & SCHED_POLL)
+        _g_numPoll++;
+
+    _g_tasks[_g_numTasks++] = task;
+
+    return 1;
+}
+
+/* Safe from interrupt handlers */
+void sched_post(sched_task_t *task, uint16_t events)
+{
+    uint16_t gint = cpld_int_disable();
+
+    task->events |= events;
+    _g_ready |= task->bit;
+
+    cpld_int_restore(gint);
+}
+
+/* SCHED_EV_TIMER after ms, then every period_ms if it isn't 0.
+ * Replaces any sleep already pending.
+ */
+void sched_sleep(sched_task_t *task, uint32_t ms, uint32_t period_ms)
+{
+    systime_timer_start(&task->timer, ms, period_ms);
+}
+
+/* One pass over every ready task */
+void sched_run_once(void)
+{
+    uint16_t ready;
+    uint16_t gint;
+    uint8_t i;
+
+    /* Timers post events, so run them first */
+    systime_process();
+
+    gint = cpld_int_disable();
+    ready = _g_ready;
+    _g_ready = 0;
+    cpld_int_restore(gint);
+
+    if (!ready && !_g_numPoll)
+    {
+        uint32_t start = systime_ticks();
+
+        /* Could have been posted to since, in which case this sleeps a
+         * tick longer than it should
+         */
+        sched_halt();
+
+        _g_idleTicks += systime_ticks() - start;
+        return;
+    }
+
+    for (i = 0; i < _g_numTasks; i++)
+    {
+        sched_task_t *task = _g_tasks[i];
+        uint16_t events;
+        uint32_t start;
+
+        if (!(ready & task->bit) && !(task->flags & SCHED_POLL))
+            continue;
+
+        gint = cpld_int_disable();
+        events = task->events;
+        task->events = 0;
+        cpld_int_restore(gint);
+
+        start = systime_ticks();
+        task->fn(events, task->arg);
+        task->ticks += systime_ticks() - start;
+        task->runs++;
+    }
+}
+
+void sched_run(void)
+{
+    for (;;)
+        sched_run_once();
+}
+
+/* Where the time went since the last reset, to stdout */
+void sched_dump(void)
+{
+    uint32_t total = systime_ticks() - _g_statsStart;
+    uint8_t i;
+
+    if (!total)
+        total = 1;
+
+    printf("%-12s %10s %10s %4s\r\n", "Task", "Runs", "ms", "%");
+
+    for (i = 0; i < _g_numTasks; i++)
+    {
+        sched_task_t *task = _g_tasks[i];
+
+        printf("%-12s %10lu %10lu %4lu\r\n", task->name, task->runs,
+            (task->ticks * 25) >> 2, (task->ticks * 100) / total);
+    }
+
+    printf("%-12s %10s %10lu %4lu\r\n", "(idle)", "",
+        (_g_idleTicks * 25) >> 2, (_g_idleTicks * 100) / total);
+}
+
+void sched_reset_stats(void)
+{
+    uint8_t i;
+
+    for (i = 0; i < _g_numTasks; i++)
+    {
+        _g_tasks[i]->runs = 0;
+        _g_tasks[i]->ticks = 0;
+    }
+
+    _g_idleTicks = 0;
+    _g_statsStart = systime_ticks();
+}
@@ -0,0 +1,62 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Cooperative task scheduler
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SCHED_H__
+#define __SCHED_H__
+
+#include <stdint.h>
+#include "systime.h"
+
+#define SCHED_MAX_TASKS     16
+
+/* Tasks pick their own event bits, apart from this one */
+#define SCHED_EV_TIMER      0x8000
+
+/* Task flags */
+#define SCHED_POLL          0x01    /* Run on every pass, events or not */
+
+typedef void (*sched_fn_t)(uint16_t events, void *arg);
+
+typedef struct
+{
+    const char *name;
+    sched_fn_t fn;
+    void *arg;
+    uint16_t bit;
+    uint8_t flags;
+    volatile uint16_t events;
+    systime_timer_t timer;
+    uint32_t runs;
+    uint32_t ticks;             /* systime ticks spent running, on average */
+} sched_task_t;
+
+void sched_init(void);
+int sched_add(sched_task_t *task, const char *name, sched_fn_t fn, void *arg, uint8_t flags);
+
+void sched_post(sched_task_t *task, uint16_t events);
+void sched_sleep(sched_task_t *task, uint32_t ms, uint32_t period_ms);
+
+void sched_run_once(void);
+void sched_run(void);
+
+void sched_dump(void);
+void sched_reset_stats(void);
+
+#endif /* __SCHED_H__ */
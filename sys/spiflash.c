@@ -23,6 +23,7 @@
 #include "eod_map.h"
 #include "eod_io.h"
 #include "mid.h"
+#include "boot.h"
 #include "spiflash.h"
 
 #define M25P80_MFG                  0x20
@@ -64,6 +65,8 @@ const flash_ops_t spi_ops = {
     &spiflash_get_geometry
 };
 
+static boot_drv_t _g_spiflashDrv = BOOT_DRV("spiflash", spiflash_init);
+
 uint32_t spiflash_get_geometry(uint16_t *block_data_len, flash_erase_block_t **block_data, uint32_t *erase_size, uint32_t *boot_offset)
 {
     *block_data = NULL;
@@ -78,6 +81,8 @@ static uint8_t spiflash_read_status(void)
     uint8_t cmd = CMD_READ_STATUS_REGISTER;
     uint8_t result;
 
+    boot_require(_g_spiflashDrv);
+
     mid_xfer_x8(M_DEV_EEPROM, 1, &cmd, 1, &result);
 
     return result;
@@ -88,6 +93,8 @@ static void spiflash_write_enable(int enable)
     uint8_t cmd = enable ?
     CMD_WRITE_ENABLE : CMD_WRITE_DISABLE;
 
+    boot_require(_g_spiflashDrv);
+
     mid_xfer_x8(M_DEV_EEPROM, 1, &cmd, 0, NULL);
 }
 
@@ -118,7 +125,10 @@ static void spiflash_erase_sector(uint32_t offset)
 
 void spiflash_init(void)
 {
+    boot_started(&_g_spiflashDrv);
+
     mid_cfg_dev(M_DEV_EEPROM, 1, M_CLK_DNEGEDGE, M_D_8BIT);
+    mid_default_speed_hz(M_DEV_EEPROM, M_DEV_EEPROM_MAX_HZ);
 }
 
 void spiflash_wait_write(void)
@@ -131,6 +141,8 @@ int spiflash_is_present(void)
     uint8_t cmd = CMD_READ_IDENTIFICATION;
     uint8_t result[3];
 
+    boot_require(_g_spiflashDrv);
+
     mid_xfer_x8(M_DEV_EEPROM, 1, &cmd, 3, result);
 
     if (result[0] != M25P80_MFG ||
@@ -0,0 +1,254 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   System uptime and software timers
+ *
+ *   TIMER overflows every SYSTIME_PERIOD counts, and the interrupt does
+ *   nothing more than count ticks and milliseconds. The app's main loop
+ *   calls systime_process(), which turns a hashed timer wheel to catch up
+ *   and runs the callbacks of any timers which have expired, so they're
+ *   free to do anything the main loop can.
+ *
+ *   Timers hash into one of WHEEL_SLOTS lists by the tick they expire on,
+ *   with a count of how many more turns of the wheel they must wait.
+ *   Starting and stopping a timer is a linked list insert or remove.
+ *   Each tick only visits the timers on one slot.
+ *
+ *   This owns TIMER, so can't be used along with adccap. As with every
+ *   other user of TIMER, each period is stretched by however long the
+ *   interrupt took to get there, so the uptime runs slightly slow.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "eod_io.h"
+#include "eod_map.h"
+#include "irq.h"
+#include "systime.h"
+
+#define WHEEL_SLOTS         32          /* Power of two */
+#define WHEEL_MASK          (WHEEL_SLOTS - 1)
+#define WHEEL_BITS          5
+
+/* Extra lists, beyond the wheel slots */
+#define TIMER_EXPIRED       WHEEL_SLOTS
+#define TIMER_IDLE          0xFF
+
+#define TIMER_RELOAD        ((uint16_t)(0x10000UL - SYSTIME_PERIOD))
+
+static volatile uint32_t _g_ticks;
+static volatile uint32_t _g_ms;
+static uint8_t _g_msQuarters;
+
+static systime_timer_t *_g_wheel[WHEEL_SLOTS + 1];
+static uint32_t _g_wheelTick;
+
+static void systime_interrupt(void);
+
+void systime_init(void)
+{
+    uint8_t i;
+
+    _g_ticks = 0;
+    _g_ms = 0;
+    _g_msQuarters = 0;
+    _g_wheelTick = 0;
+
+    for (i = 0; i <= WHEEL_SLOTS; i++)
+        _g_wheel[i] = NULL;
+
+    irq_register(STATUS_TMF, systime_interrupt);
+
+    cpld_write_atomic(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(TIMER, TIMER_RELOAD);
+    cpld_direct_write(STATUS, ~STATUS_TMF);
+    cpld_write_atomic(CONFIG, CONFIG_TMINT | CONFIG_TMRUN, CONFIG_TMINT | CONFIG_TMRUN);
+}
+
+/* Called from irq_dispatch() on STATUS_TMF */
+static void systime_interrupt(void)
+{
+    cpld_write(CONFIG, CONFIG_TMRUN, 0);
+    cpld_direct_write(TIMER, TIMER_RELOAD);
+    cpld_write(CONFIG, CONFIG_TMRUN, CONFIG_TMRUN);
+
+    _g_ticks++;
+
+    /* 6.25ms a tick */
+    _g_ms += 6;
+
+    if (++_g_msQuarters == 4)
+    {
+        _g_ms++;
+        _g_msQuarters = 0;
+    }
+}
+
+/* 32-bit reads take two instructions, so go round again if it changed */
+uint32_t systime_ms(void)
+{
+    uint32_t ms;
+
+    do {
+        ms = _g_ms;
+    } while (ms != _g_ms);
+
+    return ms;
+}
+
+uint32_t systime_ticks(void)
+{
+    uint32_t ticks;
+
+    do {
+        ticks = _g_ticks;
+    } while (ticks != _g_ticks);
+
+    return ticks;
+}
+
+static void timer_unlink(systime_timer_t *timer)
+{
+    if (timer->prev)
+        timer->prev->next = timer->next;
+    else
+        _g_wheel[timer->list] = timer->next;
+
+    if (timer->next)
+        timer->next->prev = timer->prev;
+
+    timer->list = TIMER_IDLE;
+}
+
+static void timer_link(systime_timer_t *timer, uint8_t list)
+{
+    timer->list = list;
+    timer->prev = NULL;
+    timer->next = _g_wheel[list];
+
+    if (timer->next)
+        timer->next->prev = timer;
+
+    _g_wheel[list] = timer;
+}
+
+/* Arms to expire no sooner than ticks from now */
+static void timer_arm(systime_timer_t *timer, uint32_t ticks)
+{
+    uint32_t rounds;
+
+    if (!ticks)
+        ticks = 1;
+
+    /* The wheel is behind the interrupt's count by however many ticks
+     * systime_process() hasn't caught up on yet. Counting from the wheel
+     * alone would have the timer go off that much early.
+     */
+    ticks += systime_ticks() - _g_wheelTick;
+
+    /* The slot comes round again every WHEEL_SLOTS ticks */
+    rounds = (ticks - 1) >> WHEEL_BITS;
+    timer->rounds = (rounds > 0xFFFF) ? 0xFFFF : (uint16_t)rounds;
+
+    timer_link(timer, (uint8_t)((_g_wheelTick + ticks) & WHEEL_MASK));
+}
+
+/* Rounds up, so a timer never goes off early */
+static uint32_t ms_to_ticks(uint32_t ms)
+{
+    return ((ms << 2) + 24) / 25;
+}
+
+void systime_timer_init(systime_timer_t *timer, systime_cb_t callback, void *arg)
+{
+    timer->next = NULL;
+    timer->prev = NULL;
+    timer->callback = callback;
+    timer->arg = arg;
+    timer->period = 0;
+    timer->rounds = 0;
+    timer->list = TIMER_IDLE;
+}
+
+/* Goes off after ms, then every period_ms after that if it isn't 0.
+ * Restarts the timer if it's already running. Main loop only.
+ */
+void systime_timer_start(systime_timer_t *timer, uint32_t ms, uint32_t period_ms)
+{
+    if (timer->list != TIMER_IDLE)
+        timer_unlink(timer);
+
+    timer->period = period_ms ? ms_to_ticks(period_ms) : 0;
+    timer_arm(timer, ms_to_ticks(ms));
+}
+
+/* Safe from inside any timer's callback */
+void systime_timer_stop(systime_timer_t *timer)
+{
+    if (timer->list != TIMER_IDLE)
+        timer_unlink(timer);
+}
+
+int systime_timer_armed(const systime_timer_t *timer)
+{
+    return timer->list != TIMER_IDLE;
+}
+
+/* Runs the callbacks of expired timers. Called from the main loop. */
+void systime_process(void)
+{
+    uint32_t now = systime_ticks();
+
+    while (_g_wheelTick != now)
+    {
+        systime_timer_t *timer;
+
+        _g_wheelTick++;
+        timer = _g_wheel[_g_wheelTick & WHEEL_MASK];
+
+        /* Move what's due out of the way first, so callbacks can stop
+         * and start timers, including ones on this slot.
+         */
+        while (timer)
+        {
+            systime_timer_t *next = timer->next;
+
+            if (timer->rounds)
+            {
+                timer->rounds--;
+            }
+            else
+            {
+                timer_unlink(timer);
+                timer_link(timer, TIMER_EXPIRED);
+            }
+
+            timer = next;
+        }
+
+        while ((timer = _g_wheel[TIMER_EXPIRED]) != NULL)
+        {
+            timer_unlink(timer);
+
+            if (timer->period)
+                timer_arm(timer, timer->period);
+
+            timer->callback(timer->arg);
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   System uptime and software timers
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SYSTIME_H__
+#define __SYSTIME_H__
+
+#include <stdint.h>
+#include "eod_map.h"
+
+/* TIMER counts per tick. 6.25ms, or 160 ticks a second. */
+#define SYSTIME_PERIOD      1024
+#define SYSTIME_TICK_HZ     (TIMER_HZ / SYSTIME_PERIOD)
+
+typedef void (*systime_cb_t)(void *arg);
+
+typedef struct systime_timer
+{
+    struct systime_timer *next;
+    struct systime_timer *prev;
+    systime_cb_t callback;
+    void *arg;
+    uint32_t period;            /* In ticks. 0 = one shot */
+    uint16_t rounds;            /* Turns of the wheel left to go */
+    uint8_t list;               /* Wheel slot it's on, or TIMER_IDLE */
+} systime_timer_t;
+
+void systime_init(void);
+uint32_t systime_ms(void);
+uint32_t systime_ticks(void);
+void systime_process(void);
+
+void systime_timer_init(systime_timer_t *timer, systime_cb_t callback, void *arg);
+void systime_timer_start(systime_timer_t *timer, uint32_t ms, uint32_t period_ms);
+void systime_timer_stop(systime_timer_t *timer);
+int systime_timer_armed(const systime_timer_t *timer);
+
+#endif /* __SYSTIME_H__ */
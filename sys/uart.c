@@ -148,22 +148,22 @@ void uart_open(int index, uint32_t baud, int data_bits, int parity, int stop_bit
     {
     case UARTA:
         uart->io_base = UARTA_BASE;
-        cpld_write(CONFIG, CONFIG_UAEN, CONFIG_UAEN);
+        cpld_write_atomic(CONFIG, CONFIG_UAEN, CONFIG_UAEN);
         cpld_write(TRISA, 0x0003, 0x0001);
         break;
     case UARTB:
         uart->io_base = UARTB_BASE;
-        cpld_write(CONFIG, CONFIG_UBEN, CONFIG_UBEN);
+        cpld_write_atomic(CONFIG, CONFIG_UBEN, CONFIG_UBEN);
         cpld_write(TRISB, 0x000C, 0x0008);
         break;
     case UARTC:
         uart->io_base = UARTC_BASE;
-        cpld_write(CONFIG, CONFIG_UCEN, CONFIG_UCEN);
+        cpld_write_atomic(CONFIG, CONFIG_UCEN, CONFIG_UCEN);
         cpld_write(TRISB, 0x0003, 0x0002);
         break;
     case UARTD:
         uart->io_base = UARTD_BASE;
-        cpld_write(CONFIG, CONFIG_UDEN, CONFIG_UDEN);
+        cpld_write_atomic(CONFIG, CONFIG_UDEN, CONFIG_UDEN);
         cpld_write(TRISA, 0xC000, 0x8000);
         break;
     }
@@ -182,7 +182,7 @@ void uart_pgm_open(void)
     uart->enable_rx_int    = 0;
     uart->io_base          = UARTD_BASE;
     
-    cpld_write(CONFIG, CONFIG_UDEN, 0);
+    cpld_write_atomic(CONFIG, CONFIG_UDEN, 0);
 
     uart_ns16550_init(uart);
 }
@@ -192,16 +192,16 @@ void uart_close(int index)
     switch (index)
     {
     case UARTA:
-        cpld_write(CONFIG, CONFIG_UAEN, 0);
+        cpld_write_atomic(CONFIG, CONFIG_UAEN, 0);
         break;
     case UARTB:
-        cpld_write(CONFIG, CONFIG_UBEN, 0);
+        cpld_write_atomic(CONFIG, CONFIG_UBEN, 0);
         break;
     case UARTC:
-        cpld_write(CONFIG, CONFIG_UCEN, 0);
+        cpld_write_atomic(CONFIG, CONFIG_UCEN, 0);
         break;
     case UARTD:
-        cpld_write(CONFIG, CONFIG_UDEN, 0);
+        cpld_write_atomic(CONFIG, CONFIG_UDEN, 0);
         break;
     }
 }
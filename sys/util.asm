@@ -19,9 +19,11 @@
 ;
 
 CONFIG_REG		equ	2h			;	CONFIG register
+CONFIG_GINT		equ	1h			;	GINT bit
 CONFIG_RESET	equ	8000h		;	Suicide bit
 
 extrn   _cstart_			: far
+extrn	__g_shadowRegisters	: near
 
 _TEXT   segment word public 'CODE'
 
@@ -33,6 +35,42 @@ hard_reset_ proc near
 		jmp		_cstart_
 hard_reset_ endp
 
+public  cpld_int_disable_
+public  cpld_int_restore_
+
+; uint16_t cpld_int_disable(void)
+;
+; Clears CONFIG_GINT, returning what it was for cpld_int_restore().
+;
+; The AND on the shadow is a single instruction, so can't be split by
+; the NMI. If the NMI lands after it, but before the OUT, nm_interrupt
+; sees GINT already clear and leaves it that way, but the value we
+; loaded won't have any changes its handler made to CONFIG. So CONFIG is
+; written a second time, by when GINT is off in hardware and nothing
+; else can get in.
+cpld_int_disable_ proc near
+		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
+		and		ax,		CONFIG_GINT
+		push	ax
+		and		word ptr __g_shadowRegisters + CONFIG_REG,	not CONFIG_GINT
+		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
+		out		CONFIG_REG,	ax
+		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
+		out		CONFIG_REG,	ax
+		pop		ax
+		ret
+cpld_int_disable_ endp
+
+; void cpld_int_restore(uint16_t gint)
+;
+; GINT is off in hardware until the OUT, so nothing can interrupt this.
+cpld_int_restore_ proc near
+		or		word ptr __g_shadowRegisters + CONFIG_REG,	ax
+		mov		ax,		word ptr __g_shadowRegisters + CONFIG_REG
+		out		CONFIG_REG,	ax
+		ret
+cpld_int_restore_ endp
+
 _TEXT	ends
 
 end
\ No newline at end of file
@@ -28,7 +28,11 @@ void delay_ncycles(uint16_t count);
     "loop again" \
     parm [cx];
 
-/*   How to calculate the parameter to pass to delay_ncycles:
+/*   Prefer delay_us() / delay_ms() in clock.h, which work these out for
+ *   the board they're running on. delay_ncycles() is still there for
+ *   the shortest possible delays, e.g. delay_ncycles(1).
+ *
+ *   How to calculate the parameter to pass to delay_ncycles:
  *
  *   Becasue the 8086 spends quite a lot of clock cycles
  *   fetching instructions, the overhead of fetching the
@@ -65,6 +69,36 @@ void delay_ncycles(uint16_t count);
  *   10MHz: 5570 cycles
  */
 
+/*   Copies and fills through far pointers, as REP MOVSW / STOSW with a
+ *   MOVSB / STOSB for any odd byte left over, rather than a loop in C
+ *   reloading ES for every byte. Neither may cross the end of a segment.
+ *   memcpy_far() points DS at the source while it runs, which
+ *   nm_interrupt copes with.
+ */
+void memcpy_far(void far *dst, const void far *src, uint16_t len);
+
+#pragma aux memcpy_far = \
+    "push ds" \
+    "mov ds, dx" \
+    "shr cx, 1" \
+    "rep movsw" \
+    "adc cx, cx" \
+    "rep movsb" \
+    "pop ds" \
+    parm [es di] [dx si] [cx] \
+    modify exact [cx si di];
+
+void memset_far(void far *dst, uint8_t value, uint16_t len);
+
+#pragma aux memset_far = \
+    "mov ah, al" \
+    "shr cx, 1" \
+    "rep stosw" \
+    "adc cx, cx" \
+    "rep stosb" \
+    parm [es di] [al] [cx] \
+    modify exact [ah cx di];
+
 void hard_reset(void);
 
 #endif /* __UTIL_H__ */
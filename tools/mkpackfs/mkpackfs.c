@@ -0,0 +1,262 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Host side packer for the read-only packed filesystem (sys/packfs.c)
+ *
+ *   Build with any host C compiler, e.g.
+ *
+ *     gcc -o mkpackfs mkpackfs.c
+ *
+ *   Usage, from the directory holding the content:
+ *
+ *     mkpackfs <image.bin> <file> [<file> ...]
+ *
+ *   Each file is stored under "/" followed by its path as given, with
+ *   backslashes turned into forward slashes, so "css\site.css" is
+ *   served as "/css/site.css". The resulting image is written to SPI
+ *   flash at the offset the application mounts it from.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+/* Must match sys/packfs.h */
+#define PACKFS_MAGIC        0x53464B50UL
+#define PACKFS_VERSION      1
+#define PACKFS_EMPTY        0xFFFF
+#define PACKFS_MAX_PATH     128
+
+#define HDR_SIZE            16
+#define ENTRY_SIZE          16
+
+/* 512KB below the boot area of the SPI flash */
+#define MAX_IMAGE_SIZE      0x80000UL
+#define MAX_FILES           0xFFFE
+
+typedef struct
+{
+    char path[PACKFS_MAX_PATH];
+    const char *host_path;
+    unsigned long hash;
+    unsigned long name_offset;
+    unsigned long data_offset;
+    unsigned long length;
+    unsigned int bucket;
+} file_t;
+
+static unsigned long packfs_hash(const char *path)
+{
+    unsigned long hash = 5381;
+
+    while (*path)
+        hash = (((hash << 5) + hash) + (unsigned char)*path++) & 0xFFFFFFFFUL;
+
+    return hash;
+}
+
+static void put16(unsigned char *p, unsigned int v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+}
+
+static void put32(unsigned char *p, unsigned long v)
+{
+    p[0] = v & 0xFF;
+    p[1] = (v >> 8) & 0xFF;
+    p[2] = (v >> 16) & 0xFF;
+    p[3] = (v >> 24) & 0xFF;
+}
+
+static int by_bucket(const void *a, const void *b)
+{
+    const file_t *fa = (const file_t *)a;
+    const file_t *fb = (const file_t *)b;
+
+    if (fa->bucket != fb->bucket)
+        return fa->bucket < fb->bucket ? -1 : 1;
+
+    return strcmp(fa->path, fb->path);
+}
+
+static long file_length(const char *name)
+{
+    FILE *fp = fopen(name, "rb");
+    long len;
+
+    if (!fp)
+        return -1;
+
+    fseek(fp, 0, SEEK_END);
+    len = ftell(fp);
+    fclose(fp);
+
+    return len;
+}
+
+int main(int argc, char *argv[])
+{
+    file_t *files;
+    unsigned int num_files;
+    unsigned int num_buckets;
+    unsigned long offset;
+    unsigned char *image;
+    unsigned int i;
+    FILE *out;
+
+    if (argc < 3)
+    {
+        fprintf(stderr, "Usage: %s <image.bin> <file> [<file> ...]\n", argv[0]);
+        return 1;
+    }
+
+    num_files = argc - 2;
+
+    if (num_files > MAX_FILES)
+    {
+        fprintf(stderr, "Too many files\n");
+        return 1;
+    }
+
+    files = calloc(num_files, sizeof(file_t));
+
+    for (num_buckets = 1; num_buckets < num_files; num_buckets <<= 1);
+
+    for (i = 0; i < num_files; i++)
+    {
+        const char *src = argv[i + 2];
+        char *dst = files[i].path;
+        long len;
+
+        while (*src == '.' && (src[1] == '/' || src[1] == '\\'))
+            src += 2;
+
+        if (strlen(src) + 2 > PACKFS_MAX_PATH)
+        {
+            fprintf(stderr, "%s: Path too long\n", argv[i + 2]);
+            return 1;
+        }
+
+        *dst++ = '/';
+        for (; *src; src++)
+            *dst++ = (*src == '\\') ? '/' : *src;
+        *dst = '\0';
+
+        len = file_length(argv[i + 2]);
+
+        if (len < 0)
+        {
+            fprintf(stderr, "%s: Can't open\n", argv[i + 2]);
+            return 1;
+        }
+
+        files[i].host_path = argv[i + 2];
+        files[i].length = (unsigned long)len;
+        files[i].hash = packfs_hash(files[i].path);
+        files[i].bucket = (unsigned int)(files[i].hash & (num_buckets - 1));
+    }
+
+    qsort(files, num_files, sizeof(file_t), by_bucket);
+
+    for (i = 1; i < num_files; i++)
+    {
+        if (!strcmp(files[i].path, files[i - 1].path))
+        {
+            fprintf(stderr, "%s: Duplicate path\n", files[i].path);
+            return 1;
+        }
+    }
+
+    /* Lay out names, then data */
+    offset = HDR_SIZE + (num_buckets * 2UL) + (num_files * (unsigned long)ENTRY_SIZE);
+
+    for (i = 0; i < num_files; i++)
+    {
+        files[i].name_offset = offset;
+        offset += strlen(files[i].path) + 1;
+    }
+
+    /* Word align the data, it reads quicker from NOR flash */
+    offset = (offset + 1) & ~1UL;
+
+    for (i = 0; i < num_files; i++)
+    {
+        files[i].data_offset = offset;
+        offset += (files[i].length + 1) & ~1UL;
+    }
+
+    if (offset > MAX_IMAGE_SIZE)
+    {
+        fprintf(stderr, "Image too large: %lu bytes\n", offset);
+        return 1;
+    }
+
+    image = calloc(offset, 1);
+
+    put32(image + 0, PACKFS_MAGIC);
+    put16(image + 4, PACKFS_VERSION);
+    put16(image + 6, num_buckets);
+    put16(image + 8, num_files);
+    put16(image + 10, 0);
+    put32(image + 12, offset);
+
+    for (i = 0; i < num_buckets; i++)
+        put16(image + HDR_SIZE + (i * 2), PACKFS_EMPTY);
+
+    for (i = num_files; i > 0; i--)
+        put16(image + HDR_SIZE + (files[i - 1].bucket * 2), i - 1);
+
+    for (i = 0; i < num_files; i++)
+    {
+        unsigned char *e = image + HDR_SIZE + (num_buckets * 2) + (i * ENTRY_SIZE);
+        FILE *fp;
+
+        put32(e + 0, files[i].hash);
+        put32(e + 4, files[i].name_offset);
+        put32(e + 8, files[i].data_offset);
+        put32(e + 12, files[i].length);
+
+        strcpy((char *)image + files[i].name_offset, files[i].path);
+
+        fp = fopen(files[i].host_path, "rb");
+
+        if (!fp || fread(image + files[i].data_offset, 1, files[i].length, fp) != files[i].length)
+        {
+            fprintf(stderr, "%s: Read failed\n", files[i].host_path);
+            return 1;
+        }
+
+        fclose(fp);
+
+        printf("%-40s %8lu bytes at 0x%05lX\n", files[i].path, files[i].length, files[i].data_offset);
+    }
+
+    out = fopen(argv[1], "wb");
+
+    if (!out || fwrite(image, 1, offset, out) != offset)
+    {
+        fprintf(stderr, "%s: Write failed\n", argv[1]);
+        return 1;
+    }
+
+    fclose(out);
+
+    printf("%u files, %u buckets, %lu bytes\n", num_files, num_buckets, offset);
+
+    return 0;
+}
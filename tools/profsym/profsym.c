@@ -0,0 +1,256 @@
+/*
+ *   8OD - Arduino form factor i8086 based SBC
+ *   Matthew Millman (tech.mattmillman.com)
+ *
+ *   Host side symbolizer for the sampling profiler (sys/prof.c)
+ *
+ *   Build with any host C compiler, e.g.
+ *
+ *     gcc -o profsym profsym.c
+ *
+ *   Usage:
+ *
+ *     profsym <app.map> <dump.txt>
+ *
+ *   dump.txt is whatever was captured from the UART while prof_dump()
+ *   ran. Anything before the PROF line is skipped, so a whole terminal
+ *   log will do. Each bucket is charged to the nearest symbol at or
+ *   below it in the code segment, and the totals printed busiest first.
+ *
+ *   This is free software: you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation, either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This software is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this software.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_LINE            512
+#define MAX_NAME            128
+
+typedef struct
+{
+    unsigned int seg;
+    unsigned int offset;
+    char name[MAX_NAME];
+    unsigned long count;
+} symbol_t;
+
+static symbol_t *_g_symbols;
+static size_t _g_numSymbols;
+
+static int by_offset(const void *a, const void *b)
+{
+    const symbol_t *sa = (const symbol_t *)a;
+    const symbol_t *sb = (const symbol_t *)b;
+
+    if (sa->offset != sb->offset)
+        return sa->offset < sb->offset ? -1 : 1;
+
+    return 0;
+}
+
+static int by_count(const void *a, const void *b)
+{
+    const symbol_t *sa = (const symbol_t *)a;
+    const symbol_t *sb = (const symbol_t *)b;
+
+    if (sa->count != sb->count)
+        return sa->count > sb->count ? -1 : 1;
+
+    return by_offset(a, b);
+}
+
+/*   wlink's map lists symbols under "Memory Map" as:
+ *
+ *   1008:0034+     main_
+ *
+ *   '+' and '*' just mark how the symbol is referenced.
+ */
+static int load_map(const char *filename, unsigned int cs)
+{
+    FILE *f = fopen(filename, "r");
+    char line[MAX_LINE];
+    size_t allocated = 0;
+
+    if (!f)
+    {
+        fprintf(stderr, "Can't open %s\n", filename);
+        return 0;
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned int seg;
+        unsigned int offset;
+        char name[MAX_NAME];
+        char *p = line;
+        symbol_t *sym;
+
+        if (sscanf(p, "%4x:%4x", &seg, &offset) != 2 || p[4] != ':')
+            continue;
+
+        if (seg != cs)
+            continue;
+
+        p += 9;
+
+        while (*p == '+' || *p == '*')
+            p++;
+
+        if (sscanf(p, "%127s", name) != 1)
+            continue;
+
+        if (_g_numSymbols == allocated)
+        {
+            allocated = allocated ? allocated * 2 : 256;
+            _g_symbols = (symbol_t *)realloc(_g_symbols, allocated * sizeof(symbol_t));
+
+            if (!_g_symbols)
+            {
+                fprintf(stderr, "Out of memory\n");
+                fclose(f);
+                return 0;
+            }
+        }
+
+        sym = &_g_symbols[_g_numSymbols++];
+        sym->seg = seg;
+        sym->offset = offset;
+        strcpy(sym->name, name);
+        sym->count = 0;
+    }
+
+    fclose(f);
+
+    qsort(_g_symbols, _g_numSymbols, sizeof(symbol_t), by_offset);
+
+    return 1;
+}
+
+/* Last symbol at or below offset, NULL if there isn't one */
+static symbol_t *find_symbol(unsigned int offset)
+{
+    size_t lo = 0;
+    size_t hi = _g_numSymbols;
+
+    while (lo < hi)
+    {
+        size_t mid = (lo + hi) / 2;
+
+        if (_g_symbols[mid].offset <= offset)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    return lo ? &_g_symbols[lo - 1] : NULL;
+}
+
+int main(int argc, char *argv[])
+{
+    FILE *f;
+    char line[MAX_LINE];
+    unsigned int cs = 0;
+    unsigned int shift = 0;
+    unsigned long samples = 0;
+    unsigned long outside = 0;
+    unsigned long unknown = 0;
+    unsigned long counted = 0;
+    int found = 0;
+    size_t i;
+
+    if (argc != 3)
+    {
+        fprintf(stderr, "Usage: profsym <app.map> <dump.txt>\n");
+        return 1;
+    }
+
+    f = fopen(argv[2], "r");
+
+    if (!f)
+    {
+        fprintf(stderr, "Can't open %s\n", argv[2]);
+        return 1;
+    }
+
+    while (fgets(line, sizeof(line), f))
+    {
+        if (sscanf(line, "PROF %x %x %lx %lx", &cs, &shift, &samples, &outside) == 4)
+        {
+            found = 1;
+            break;
+        }
+    }
+
+    if (!found)
+    {
+        fprintf(stderr, "No PROF header in %s\n", argv[2]);
+        fclose(f);
+        return 1;
+    }
+
+    if (!load_map(argv[1], cs))
+    {
+        fclose(f);
+        return 1;
+    }
+
+    if (!_g_numSymbols)
+        fprintf(stderr, "No symbols for segment %04X in %s\n", cs, argv[1]);
+
+    while (fgets(line, sizeof(line), f))
+    {
+        unsigned int offset;
+        unsigned long count;
+        symbol_t *sym;
+
+        if (!strncmp(line, "END", 3))
+            break;
+
+        if (sscanf(line, "%x %lx", &offset, &count) != 2)
+            continue;
+
+        counted += count;
+        sym = find_symbol(offset);
+
+        if (sym)
+            sym->count += count;
+        else
+            unknown += count;
+    }
+
+    fclose(f);
+
+    qsort(_g_symbols, _g_numSymbols, sizeof(symbol_t), by_count);
+
+    printf("%lu samples, %lu outside %04X, %u byte buckets\n\n", samples, outside, cs, 1u << shift);
+    printf("   Count      %%  Symbol\n");
+
+    for (i = 0; i < _g_numSymbols && _g_symbols[i].count; i++)
+    {
+        printf("%8lu %6.2f  %s (%04X:%04X)\n", _g_symbols[i].count,
+            samples ? (100.0 * _g_symbols[i].count) / samples : 0.0,
+            _g_symbols[i].name, _g_symbols[i].seg, _g_symbols[i].offset);
+    }
+
+    if (unknown)
+        printf("%8lu %6.2f  (below first symbol)\n", unknown, samples ? (100.0 * unknown) / samples : 0.0);
+
+    if (counted + outside < samples)
+        printf("\n%lu samples lost to saturated buckets\n", samples - outside - counted);
+
+    free(_g_symbols);
+
+    return 0;
+}